@@ -0,0 +1,33 @@
+#include "Cache.h"
+
+#include <mc_rtc/logging.h>
+
+#include <cstdlib>
+
+namespace mc_rtc::magnum
+{
+
+bfs::path cacheDirectory()
+{
+  bfs::path base;
+#ifdef _WIN32
+  if(const char * local = std::getenv("LOCALAPPDATA")) { base = local; }
+#elif defined(__APPLE__)
+  if(const char * home = std::getenv("HOME")) { base = bfs::path(home) / "Library" / "Caches"; }
+#else
+  if(const char * xdg = std::getenv("XDG_CACHE_HOME")) { base = xdg; }
+  else if(const char * home = std::getenv("HOME")) { base = bfs::path(home) / ".cache"; }
+#endif
+  if(base.empty()) { return {}; }
+  bfs::path out = base / "mc_rtc-magnum";
+  boost::system::error_code ec;
+  bfs::create_directories(out, ec);
+  if(ec)
+  {
+    mc_rtc::log::warning("Failed to create the cache directory {}: {}", out.string(), ec.message());
+    return {};
+  }
+  return out;
+}
+
+} // namespace mc_rtc::magnum
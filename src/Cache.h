@@ -0,0 +1,11 @@
+#pragma once
+
+#include "widgets/utils.h"
+
+namespace mc_rtc::magnum
+{
+
+/** Per-user cache directory of the GUI (created if needed), empty if it could not be determined */
+bfs::path cacheDirectory();
+
+} // namespace mc_rtc::magnum
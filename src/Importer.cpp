@@ -0,0 +1,259 @@
+#include "Importer.h"
+#include "MeshLod.h"
+#include "MeshOptimizer.h"
+#include "StlLoader.h"
+
+#include <Corrade/Utility/ConfigurationGroup.h>
+
+#include <algorithm>
+
+namespace mc_rtc::magnum
+{
+
+namespace
+{
+
+/** Bounds used for culling */
+Range3D meshBounds(const Trade::MeshData & mesh)
+{
+  Vector3 min{Constants::inf()};
+  Vector3 max{-Constants::inf()};
+  for(const Vector3 & p : mesh.positions3DAsArray())
+  {
+    min = Math::min(min, p);
+    max = Math::max(max, p);
+  }
+  return {min, max};
+}
+
+/** Import an STL file without going through Assimp */
+bool importStl(ImportJob & job)
+{
+  auto mesh = loadStl(job.path);
+  if(!mesh) { return false; }
+  auto & out = job.data;
+  out.meshes = Containers::Array<Containers::Optional<Trade::MeshData>>{1};
+  out.bounds = Containers::Array<Range3D>{1};
+  out.bounds[0] = meshBounds(*mesh);
+  out.meshes[0] = std::move(mesh);
+  return true;
+}
+
+/** Meshes with less triangles are never simplified */
+constexpr size_t MinLodTriangles = 512;
+/** Maximum number of levels of detail per mesh */
+constexpr size_t MaxLods = 4;
+
+/** Generate up to MaxLods simplified versions of each mesh, each level has at most 60% of the previous one triangles
+ *
+ * The simplified meshes are added at the end of the meshes so the scene still references the full resolution ones
+ */
+void generateLods(ImportedData & data)
+{
+  std::vector<Trade::MeshData> meshes;
+  std::vector<Range3D> bounds;
+  std::vector<ImportedData::Lod> lods;
+  size_t count = data.meshes.size();
+  for(size_t i = 0; i < count; ++i)
+  {
+    if(!data.meshes[i]) { continue; }
+    const auto & mesh = *data.meshes[i];
+    size_t triangles = (mesh.isIndexed() ? mesh.indexCount() : mesh.vertexCount()) / 3;
+    if(triangles < MinLodTriangles) { continue; }
+    float diagonal = data.bounds[i].size().length();
+    size_t levels = 0;
+    for(float cell = diagonal / 128.0f; levels < MaxLods && cell < diagonal / 4.0f; cell *= 2.0f)
+    {
+      auto lod = simplifyMesh(mesh, cell);
+      if(!lod) { break; }
+      size_t lodTriangles = lod->indexCount() / 3;
+      if(lodTriangles < 8) { break; }
+      if(10 * lodTriangles > 6 * triangles) { continue; }
+      lods.push_back({static_cast<UnsignedInt>(i), static_cast<UnsignedInt>(count + meshes.size()), cell});
+      bounds.push_back(meshBounds(*lod));
+      meshes.push_back(std::move(*lod));
+      triangles = lodTriangles;
+      levels++;
+    }
+  }
+  if(meshes.empty()) { return; }
+  Containers::Array<Containers::Optional<Trade::MeshData>> allMeshes{count + meshes.size()};
+  Containers::Array<Range3D> allBounds{count + meshes.size()};
+  for(size_t i = 0; i < count; ++i)
+  {
+    allMeshes[i] = std::move(data.meshes[i]);
+    allBounds[i] = data.bounds[i];
+  }
+  for(size_t i = 0; i < meshes.size(); ++i)
+  {
+    allMeshes[count + i] = std::move(meshes[i]);
+    allBounds[count + i] = bounds[i];
+  }
+  data.meshes = std::move(allMeshes);
+  data.bounds = std::move(allBounds);
+  data.lods = Containers::Array<ImportedData::Lod>{NoInit, lods.size()};
+  for(size_t i = 0; i < lods.size(); ++i) { data.lods[i] = lods[i]; }
+}
+
+/** Run \ref optimizeMesh on the meshes that support it */
+void optimize(ImportedData & data)
+{
+  data.decode = Containers::Array<Matrix4>{data.meshes.size()};
+  for(size_t i = 0; i < data.meshes.size(); ++i)
+  {
+    if(!data.meshes[i]) { continue; }
+    auto optimized = optimizeMesh(*data.meshes[i], data.decode[i]);
+    if(!optimized) { continue; }
+    data.meshes[i] = std::move(optimized);
+    data.bounds[i] = meshBounds(*data.meshes[i]);
+  }
+}
+
+bool import(Trade::AbstractImporter & importer, ImportJob & job)
+{
+  auto & out = job.data;
+  const auto & path = job.path;
+  if(!importer.openFile(path)) { return false; }
+  out.textures = Containers::Array<Containers::Optional<ImportedData::Texture>>{importer.textureCount()};
+  for(UnsignedInt i = 0; i < importer.textureCount(); ++i)
+  {
+    Containers::Optional<Trade::TextureData> textureData = importer.texture(i);
+    if(!textureData || textureData->type() != Trade::TextureType::Texture2D)
+    {
+      Warning{} << "Cannot load texture properties, skipping";
+      continue;
+    }
+
+    Containers::Optional<Trade::ImageData2D> imageData = importer.image2D(textureData->image());
+    if(!imageData
+       || (imageData->format() != PixelFormat::RGB8Unorm && imageData->format() != PixelFormat::RGBA8Unorm))
+    {
+      Warning{} << "Cannot load texture image, skipping";
+      continue;
+    }
+    out.textures[i] = ImportedData::Texture{textureData->magnificationFilter(), textureData->minificationFilter(),
+                                            textureData->mipmapFilter(), textureData->wrapping().xy(),
+                                            std::move(*imageData)};
+  }
+  /* Load all materials. Materials that fail to load will be NullOpt. */
+  out.materials = Containers::Array<Containers::Optional<Trade::PhongMaterialData>>{importer.materialCount()};
+  for(UnsignedInt i = 0; i != importer.materialCount(); ++i)
+  {
+    Containers::Optional<Trade::MaterialData> materialData = importer.material(i);
+    if(!materialData || !(materialData->types() & Trade::MaterialType::Phong))
+    {
+      Warning{} << "Cannot load material, skipping";
+      continue;
+    }
+
+    out.materials[i] = std::move(static_cast<Trade::PhongMaterialData &>(*materialData));
+  }
+  /* Load all meshes. Meshes that fail to load will be NullOpt. */
+  out.meshes = Containers::Array<Containers::Optional<Trade::MeshData>>{importer.meshCount()};
+  out.bounds = Containers::Array<Range3D>{importer.meshCount()};
+  for(UnsignedInt i = 0; i != importer.meshCount(); ++i)
+  {
+    Containers::Optional<Trade::MeshData> meshData = importer.mesh(i);
+    if(!meshData || !meshData->hasAttribute(Trade::MeshAttribute::Normal))
+    {
+      Warning{} << "Cannot load mesh " << i << " in skipping " << path.c_str();
+      continue;
+    }
+
+    out.bounds[i] = meshBounds(*meshData);
+    out.meshes[i] = std::move(meshData);
+  }
+  if(importer.defaultScene() != -1)
+  {
+    out.scene = importer.scene(importer.defaultScene());
+    if(!out.scene) { Error{} << "Cannot load scene from " << path.c_str(); }
+  }
+  importer.close();
+  return true;
+}
+
+} // namespace
+
+ImportPool::ImportPool(size_t threads, std::function<void()> notify, const ImportOptions & options)
+: notify_(std::move(notify)), options_(options),
+  cache_(options.cache, std::string(options.lods ? "lods" : "") + (options.optimize ? "optimized" : ""))
+{
+  threads = std::max<size_t>(threads, 1);
+  /* Plugins are loaded from this thread, the workers only use their own importer instance */
+  for(size_t i = 0; i < threads; ++i)
+  {
+    auto & w = *workers_.emplace_back(std::make_unique<Worker>());
+    w.importer = w.manager.loadAndInstantiate("AssimpImporter");
+    if(!w.importer)
+    {
+      Error{} << "Failed to load AssimpImporter, meshes will not be displayed";
+      workers_.pop_back();
+      break;
+    }
+    w.importer->configuration().setValue("ImportColladaIgnoreUpDirection", true);
+    w.importer->configuration().group("postprocess")->setValue("PreTransformVertices", true);
+  }
+  for(auto & w : workers_)
+  {
+    auto * worker = w.get();
+    w->thread = std::thread([this, worker]() { run(*worker); });
+  }
+}
+
+ImportPool::~ImportPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for(auto & w : workers_) { w->thread.join(); }
+}
+
+ImportJobPtr ImportPool::submit(const std::string & path)
+{
+  auto job = std::make_shared<ImportJob>();
+  job->path = path;
+  if(workers_.empty())
+  {
+    job->done = true;
+    return job;
+  }
+  pending_++;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(job);
+  }
+  cv_.notify_one();
+  return job;
+}
+
+void ImportPool::run(Worker & worker)
+{
+  while(true)
+  {
+    ImportJobPtr job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if(stop_) { return; }
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    if(!cache_.load(job->path, job->data))
+    {
+      /* Fallback to Assimp if the STL loader fails */
+      if((isStl(job->path) && importStl(*job)) || import(*worker.importer, *job))
+      {
+        if(options_.lods) { generateLods(job->data); }
+        if(options_.optimize) { optimize(job->data); }
+        cache_.store(job->path, job->data);
+      }
+    }
+    job->done = true;
+    pending_--;
+    if(notify_) { notify_(); }
+  }
+}
+
+} // namespace mc_rtc::magnum
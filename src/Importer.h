@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Camera.h"
+#include "MeshCache.h"
+
+#include <Corrade/Utility/Path.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/Sampler.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+/** CPU side result of a mesh import, ready to be uploaded to the GPU */
+struct ImportedData
+{
+  struct Texture
+  {
+    SamplerFilter magnificationFilter;
+    SamplerFilter minificationFilter;
+    SamplerMipmap mipmapFilter;
+    Math::Vector2<SamplerWrapping> wrapping;
+    Trade::ImageData2D image;
+  };
+  Containers::Array<Containers::Optional<Trade::MeshData>> meshes;
+  /** Bounds of each mesh */
+  Containers::Array<Range3D> bounds;
+  /** Transformation from the quantized positions of each mesh to the original ones, empty if no mesh is quantized */
+  Containers::Array<Matrix4> decode;
+  /** Simplified version of a mesh, stored with the other meshes */
+  struct Lod
+  {
+    /** Index of the full resolution mesh */
+    UnsignedInt mesh;
+    /** Index of the simplified mesh */
+    UnsignedInt lod;
+    /** Geometric error of the simplified mesh, in the unit of the full resolution mesh */
+    float error;
+  };
+  /** Levels of detail, sorted by mesh then increasing error */
+  Containers::Array<Lod> lods;
+  Containers::Array<Containers::Optional<Trade::PhongMaterialData>> materials;
+  Containers::Array<Containers::Optional<Texture>> textures;
+  Containers::Optional<Trade::SceneData> scene;
+  /** Mesh cache entry referenced by the meshes and textures when they were loaded from the \ref MeshCache */
+  Containers::Optional<Containers::Array<const char, Utility::Path::MapDeleter>> mapping;
+};
+
+/** A mesh file being imported by the \ref ImportPool */
+struct ImportJob
+{
+  std::string path;
+  /** Only valid once \ref done is true */
+  ImportedData data;
+  std::atomic<bool> done{false};
+};
+
+using ImportJobPtr = std::shared_ptr<ImportJob>;
+
+/** Settings of the \ref ImportPool */
+struct ImportOptions
+{
+  /** Directory of the \ref MeshCache, the cache is disabled if it is empty */
+  bfs::path cache;
+  /** Generate simplified meshes used as levels of detail, see \ref simplifyMesh */
+  bool lods = true;
+  /** Run \ref optimizeMesh on the meshes */
+  bool optimize = false;
+};
+
+/** Imports mesh files on worker threads
+ *
+ * Each worker owns its plugin manager and AssimpImporter instance, parses the file, decodes its images and computes
+ * the bounds of its meshes. The render thread only has to upload the results.
+ *
+ * Files found in the \ref MeshCache are loaded from there instead, new imports are stored in the cache. STL files are
+ * loaded with \ref loadStl.
+ */
+struct ImportPool
+{
+  /** Start \p threads workers, \p notify is called from a worker thread when a job is done */
+  ImportPool(size_t threads, std::function<void()> notify, const ImportOptions & options = {});
+
+  ~ImportPool();
+
+  ImportPool(const ImportPool &) = delete;
+  ImportPool & operator=(const ImportPool &) = delete;
+
+  /** Queue the import of \p path */
+  ImportJobPtr submit(const std::string & path);
+
+  /** Number of jobs that are queued or running */
+  inline size_t pending() const noexcept { return pending_; }
+
+private:
+  struct Worker
+  {
+    PluginManager::Manager<Trade::AbstractImporter> manager;
+    Containers::Pointer<Trade::AbstractImporter> importer;
+    std::thread thread;
+  };
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::function<void()> notify_;
+  ImportOptions options_;
+  MeshCache cache_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<ImportJobPtr> queue_;
+  std::atomic<size_t> pending_{0};
+  bool stop_ = false;
+
+  void run(Worker & worker);
+};
+
+} // namespace mc_rtc::magnum
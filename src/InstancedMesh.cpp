@@ -0,0 +1,51 @@
+#include "InstancedMesh.h"
+
+#include <Magnum/Primitives/Axis.h>
+
+namespace mc_rtc::magnum
+{
+
+InstancedMesh::InstancedMesh(const Trade::MeshData & data) : mesh_(MeshTools::compile(data))
+{
+  mesh_.addVertexBufferInstanced(buffer_, 1, 0, Shaders::PhongGL::TransformationMatrix{},
+                                 Shaders::PhongGL::NormalMatrix{}, Shaders::PhongGL::Color4{});
+}
+
+void InstancedMesh::add(const Matrix4 & transformation, const Color4 & color)
+{
+  instances_.push_back({transformation, transformation.normalMatrix(), color});
+}
+
+void InstancedMesh::draw(Shaders::PhongGL & shader, const Matrix4 & projection)
+{
+  drawn_ = instances_.size();
+  if(instances_.empty()) { return; }
+  buffer_.setData({instances_.data(), instances_.size() * sizeof(Instance)}, GL::BufferUsage::StreamDraw);
+  mesh_.setInstanceCount(static_cast<Int>(instances_.size()));
+  shader.setProjectionMatrix(projection).draw(mesh_);
+  instances_.clear();
+}
+
+InstancedAxes::InstancedAxes(ShaderCache & shaders) : mesh_(MeshTools::compile(Primitives::axis3D()))
+{
+  shaders.compile(shader_, Shaders::FlatGL3D::Configuration{}.setFlags(
+                               Shaders::FlatGL3D::Flag::InstancedTransformation | Shaders::FlatGL3D::Flag::VertexColor));
+  mesh_.addVertexBufferInstanced(buffer_, 1, 0, Shaders::FlatGL3D::TransformationMatrix{});
+}
+
+void InstancedAxes::add(const Matrix4 & transformation)
+{
+  instances_.push_back(transformation);
+}
+
+void InstancedAxes::draw(const Matrix4 & transformationProjection)
+{
+  drawn_ = instances_.size();
+  if(instances_.empty()) { return; }
+  buffer_.setData(Containers::arrayView(instances_.data(), instances_.size()), GL::BufferUsage::StreamDraw);
+  mesh_.setInstanceCount(static_cast<Int>(instances_.size()));
+  shader_.setTransformationProjectionMatrix(transformationProjection).draw(mesh_);
+  instances_.clear();
+}
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Camera.h"
+#include "ShaderCache.h"
+
+#include <Magnum/GL/Buffer.h>
+#include <Magnum/Math/Matrix3.h>
+#include <Magnum/Shaders/FlatGL.h>
+#include <Magnum/Shaders/PhongGL.h>
+
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+/** Draws all the copies of a mesh added during a frame with a single instanced draw call
+ *
+ * The shader must be created with \ref Shaders::PhongGL::Flag::InstancedTransformation and \ref
+ * Shaders::PhongGL::Flag::VertexColor
+ */
+struct InstancedMesh
+{
+  explicit InstancedMesh(const Trade::MeshData & data);
+
+  /** Add an instance, \p transformation is relative to the camera */
+  void add(const Matrix4 & transformation, const Color4 & color);
+
+  /** Draw all the instances added since the last call and clear them */
+  void draw(Shaders::PhongGL & shader, const Matrix4 & projection);
+
+  /** Number of instances drawn by the last \ref draw call */
+  inline size_t drawn() const noexcept { return drawn_; }
+
+private:
+  struct Instance
+  {
+    Matrix4 transformation;
+    Matrix3x3 normal;
+    Color4 color;
+  };
+  GL::Buffer buffer_;
+  GL::Mesh mesh_;
+  std::vector<Instance> instances_;
+  size_t drawn_ = 0;
+};
+
+/** Draws all the coordinate frames added during a frame with a single instanced draw call */
+struct InstancedAxes
+{
+  explicit InstancedAxes(ShaderCache & shaders);
+
+  /** Add a frame, \p transformation is in world coordinates and includes the axes' scale */
+  void add(const Matrix4 & transformation);
+
+  /** Draw all the frames added since the last call and clear them */
+  void draw(const Matrix4 & transformationProjection);
+
+  /** Number of frames drawn by the last \ref draw call */
+  inline size_t drawn() const noexcept { return drawn_; }
+
+private:
+  Shaders::FlatGL3D shader_{NoCreate};
+  GL::Buffer buffer_;
+  GL::Mesh mesh_;
+  std::vector<Matrix4> instances_;
+  size_t drawn_ = 0;
+};
+
+} // namespace mc_rtc::magnum
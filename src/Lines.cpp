@@ -0,0 +1,259 @@
+#include "Lines.h"
+
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/Shaders/Line.h>
+
+#include <algorithm>
+
+namespace mc_rtc::magnum
+{
+
+void writeLineSegment(LineVertex * out, const Vector3 & start, const Vector3 & end, const Color4 & color) noexcept
+{
+  constexpr UnsignedInt up = UnsignedInt(Shaders::LineVertexAnnotation::Up);
+  constexpr UnsignedInt begin = UnsignedInt(Shaders::LineVertexAnnotation::Begin);
+  /* Without joins the shader only looks at the other end of the segment */
+  out[0] = {start, start, end, begin | up, color};
+  out[1] = {start, start, end, begin, color};
+  out[2] = {end, start, end, up, color};
+  out[3] = {end, start, end, 0, color};
+}
+
+void reserveLineIndices(std::vector<UnsignedInt> & indices, GL::Buffer & buffer, size_t segments)
+{
+  size_t current = indices.size() / LineSegmentIndices;
+  if(current >= segments) { return; }
+  size_t target = std::max<size_t>(segments, 2 * current);
+  indices.reserve(target * LineSegmentIndices);
+  for(size_t i = current; i < target; ++i)
+  {
+    auto v = static_cast<UnsignedInt>(i * LineSegmentVertices);
+    indices.insert(indices.end(), {v, v + 1, v + 2, v + 2, v + 1, v + 3});
+  }
+  buffer.setData(Containers::arrayView(indices.data(), indices.size()), GL::BufferUsage::StaticDraw);
+}
+
+void setupLineMesh(GL::Mesh & mesh, GL::Buffer & vertices, GL::Buffer & indices)
+{
+  mesh.setPrimitive(MeshPrimitive::Triangles)
+      .addVertexBuffer(vertices, 0, Shaders::LineGL3D::Position{}, Shaders::LineGL3D::PreviousPosition{},
+                       Shaders::LineGL3D::NextPosition{}, Shaders::LineGL3D::Annotation{},
+                       Shaders::LineGL3D::Color4{})
+      .setIndexBuffer(indices, 0, MeshIndexType::UnsignedInt);
+}
+
+LineBatch::LineBatch(ShaderCache & shaders)
+{
+  shaders.compile(shader_, Shaders::LineGL3D::Configuration{}.setFlags(Shaders::LineGL3D::Flag::VertexColor));
+}
+
+void LineBatch::add(const Vector3 & start, const Vector3 & end, const Color4 & color, float width)
+{
+  Bucket * bucket = nullptr;
+  for(auto & b : buckets_)
+  {
+    if(b.width == width)
+    {
+      bucket = &b;
+      break;
+    }
+  }
+  if(!bucket)
+  {
+    bucket = &buckets_.emplace_back();
+    bucket->width = width;
+    setupLineMesh(bucket->mesh, bucket->buffer, indexBuffer_);
+  }
+  auto & vertices = bucket->vertices;
+  vertices.resize(vertices.size() + LineSegmentVertices);
+  writeLineSegment(&vertices[vertices.size() - LineSegmentVertices], start, end, color);
+}
+
+void LineBatch::draw(SceneGraph::Camera3D & camera)
+{
+  drawn_ = 0;
+  /* The quads are expanded in screen space, their winding depends on the line direction */
+  GL::Renderer::disable(GL::Renderer::Feature::FaceCulling);
+  shader_.setViewportSize(Vector2{GL::defaultFramebuffer.viewport().size()})
+      .setTransformationProjectionMatrix(camera.projectionMatrix() * camera.cameraMatrix())
+      .setSmoothness(1.0f);
+  for(auto & b : buckets_)
+  {
+    if(b.vertices.empty()) { continue; }
+    size_t segments = b.vertices.size() / LineSegmentVertices;
+    reserveLineIndices(indices_, indexBuffer_, segments);
+    b.buffer.setData(Containers::arrayView(b.vertices.data(), b.vertices.size()), GL::BufferUsage::StreamDraw);
+    b.mesh.setCount(static_cast<Int>(segments * LineSegmentIndices));
+    shader_.setWidth(b.width).draw(b.mesh);
+    drawn_ += segments;
+    b.vertices.clear();
+  }
+  GL::Renderer::enable(GL::Renderer::Feature::FaceCulling);
+}
+
+LineRing::LineRing(size_t capacity) : points_(std::max<size_t>(capacity, 2))
+{
+  setupLineMesh(mesh_, vertexBuffer_, indexBuffer_);
+}
+
+void LineRing::push(const Vector3 & point)
+{
+  points_.push_back(point);
+  pushed_++;
+  if(pushed_ > 1) { dirty_ = std::min(dirty_ + 1, slots()); }
+}
+
+void LineRing::clear() noexcept
+{
+  points_.clear();
+  pushed_ = 0;
+  dirty_ = 0;
+}
+
+void LineRing::upload()
+{
+  size_t count = segments();
+  if(count > allocated_)
+  {
+    /* Only happens before the ring wraps around: slot k holds segment k and everything is re-uploaded */
+    allocated_ = std::min(slots(), std::max<size_t>({count, 2 * allocated_, 64}));
+    vertexBuffer_.setData({nullptr, allocated_ * LineSegmentVertices * sizeof(LineVertex)},
+                          GL::BufferUsage::DynamicDraw);
+    reserveLineIndices(indices_, indexBuffer_, allocated_);
+    dirty_ = count;
+  }
+  if(dirty_ == 0) { return; }
+  /* Segments to upload are the newest ones, k in [first, pushed_ - 1) */
+  uint64_t first = pushed_ - 1 - dirty_;
+  uint64_t oldest = pushed_ - points_.size();
+  staging_.resize(dirty_ * LineSegmentVertices);
+  for(size_t i = 0; i < dirty_; ++i)
+  {
+    size_t p = static_cast<size_t>(first + i - oldest);
+    writeLineSegment(&staging_[i * LineSegmentVertices], points_[p], points_[p + 1], Color4{1.0f});
+  }
+  /* Upload in at most two chunks when the range wraps around the end of the buffer */
+  size_t slot = static_cast<size_t>(first % slots());
+  size_t head = std::min(dirty_, slots() - slot);
+  constexpr size_t segmentSize = LineSegmentVertices * sizeof(LineVertex);
+  vertexBuffer_.setSubData(slot * segmentSize, Containers::arrayView(staging_.data(), head * LineSegmentVertices));
+  if(head < dirty_)
+  {
+    vertexBuffer_.setSubData(0, Containers::arrayView(staging_.data() + head * LineSegmentVertices,
+                                                      (dirty_ - head) * LineSegmentVertices));
+  }
+  dirty_ = 0;
+}
+
+void LineRing::draw(Shaders::LineGL3D & shader)
+{
+  size_t count = segments();
+  if(count == 0) { return; }
+  upload();
+  /* Segments are not joined so the order of the slots does not matter, the used slots are always [0, count) */
+  mesh_.setCount(static_cast<Int>(count * LineSegmentIndices));
+  GL::Renderer::disable(GL::Renderer::Feature::FaceCulling);
+  shader.draw(mesh_);
+  GL::Renderer::enable(GL::Renderer::Feature::FaceCulling);
+}
+
+namespace
+{
+
+constexpr size_t LodLevels = 3;
+constexpr size_t LodBlockFactor = 8;
+
+} // namespace
+
+LineLod::LineLod(size_t capacity) : full_(capacity)
+{
+  size_t block = 1;
+  for(size_t i = 0; i < LodLevels; ++i)
+  {
+    block *= LodBlockFactor;
+    levels_.emplace_back(block, levelCapacity(full_.capacity(), block));
+  }
+}
+
+size_t LineLod::levelCapacity(size_t capacity, size_t block) noexcept
+{
+  return 2 * (capacity / block) + 2;
+}
+
+size_t LineLod::decimation(size_t level) noexcept
+{
+  size_t block = 1;
+  for(size_t i = 0; i < level; ++i) { block *= LodBlockFactor; }
+  return std::max<size_t>(block / 2, 1);
+}
+
+void LineLod::push(const Vector3 & point)
+{
+  const auto & points = full_.points();
+  if(points.full() && points.size() > 1) { length_ -= (points[1] - points[0]).length(); }
+  if(!points.empty()) { length_ += (point - points.back()).length(); }
+  full_.push(point);
+  for(auto & l : levels_)
+  {
+    l.pending.push_back(point);
+    if(l.pending.size() < l.block) { continue; }
+    /* Point furthest away from the block's chord */
+    const Vector3 & a = l.pending.front();
+    Vector3 chord = l.pending.back() - a;
+    float chordLength = chord.dot();
+    size_t furthest = l.block / 2;
+    float distance = -1.0f;
+    for(size_t i = 1; i + 1 < l.pending.size(); ++i)
+    {
+      Vector3 v = l.pending[i] - a;
+      float d = chordLength > 0.0f ? (v - chord * (Math::dot(v, chord) / chordLength)).dot() : v.dot();
+      if(d > distance)
+      {
+        distance = d;
+        furthest = i;
+      }
+    }
+    l.line.push(a);
+    l.line.push(l.pending[furthest]);
+    l.pending.clear();
+  }
+}
+
+void LineLod::clear() noexcept
+{
+  full_.clear();
+  for(auto & l : levels_)
+  {
+    l.line.clear();
+    l.pending.clear();
+  }
+  length_ = 0.0;
+}
+
+size_t LineLod::level(float tolerance) const noexcept
+{
+  size_t segments = full_.points().size() > 1 ? full_.points().size() - 1 : 0;
+  if(segments == 0) { return 0; }
+  double average = std::max(length_, 0.0) / static_cast<double>(segments);
+  size_t level = 0;
+  while(level < levels_.size() && average * static_cast<double>(decimation(level + 1)) < tolerance) { ++level; }
+  return level;
+}
+
+void LineLod::draw(Shaders::LineGL3D & shader, size_t level)
+{
+  if(level == 0 || level > levels_.size()) { full_.draw(shader); }
+  else { levels_[level - 1].line.draw(shader); }
+}
+
+const std::vector<Vector3> & LineLod::tail(size_t level)
+{
+  tail_.clear();
+  if(level == 0 || level > levels_.size()) { return tail_; }
+  const auto & l = levels_[level - 1];
+  if(!l.line.points().empty()) { tail_.push_back(l.line.points().back()); }
+  tail_.insert(tail_.end(), l.pending.begin(), l.pending.end());
+  return tail_;
+}
+
+} // namespace mc_rtc::magnum
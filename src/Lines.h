@@ -0,0 +1,176 @@
+#pragma once
+
+#include "Camera.h"
+#include "RingBuffer.h"
+#include "ShaderCache.h"
+
+#include <Magnum/GL/Buffer.h>
+#include <Magnum/Shaders/LineGL.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+/** Vertex layout expected by \ref Shaders::LineGL3D with \ref Shaders::LineGL3D::Flag::VertexColor
+ *
+ * Each segment is expanded to a screen-space quad by the shader, segments are not joined so they can be appended or
+ * overwritten independently of their neighbours.
+ */
+struct LineVertex
+{
+  Vector3 position;
+  Vector3 previousPosition;
+  Vector3 nextPosition;
+  UnsignedInt annotation;
+  Color4 color;
+};
+
+/** Number of vertices used by a segment */
+constexpr size_t LineSegmentVertices = 4;
+
+/** Number of indices used by a segment */
+constexpr size_t LineSegmentIndices = 6;
+
+/** Write the vertices of the segment [start, end] in \p out which must have room for \ref LineSegmentVertices */
+void writeLineSegment(LineVertex * out, const Vector3 & start, const Vector3 & end, const Color4 & color) noexcept;
+
+/** Make sure \p indices holds the indices for at least \p segments segments, re-uploads \p buffer if it grew */
+void reserveLineIndices(std::vector<UnsignedInt> & indices, GL::Buffer & buffer, size_t segments);
+
+/** Setup \p mesh to draw \ref LineVertex data stored in \p vertices with the indices in \p indices */
+void setupLineMesh(GL::Mesh & mesh, GL::Buffer & vertices, GL::Buffer & indices);
+
+/** Accumulates line segments during a frame and draws them with one call per line width */
+struct LineBatch
+{
+  explicit LineBatch(ShaderCache & shaders);
+
+  /** Add a segment, \p width is in pixels */
+  void add(const Vector3 & start, const Vector3 & end, const Color4 & color, float width);
+
+  /** Draw all the segments added since the last call and clear them */
+  void draw(SceneGraph::Camera3D & camera);
+
+  /** Number of segments drawn by the last \ref draw call */
+  inline size_t drawn() const noexcept { return drawn_; }
+
+private:
+  struct Bucket
+  {
+    float width;
+    std::vector<LineVertex> vertices;
+    GL::Buffer buffer;
+    GL::Mesh mesh;
+  };
+  Shaders::LineGL3D shader_{NoCreate};
+  std::vector<Bucket> buckets_;
+  std::vector<UnsignedInt> indices_;
+  GL::Buffer indexBuffer_;
+  size_t drawn_ = 0;
+};
+
+/** Fixed-capacity history of points drawn as a continuous line
+ *
+ * The points are kept in a \ref RingBuffer and the segments joining them are mirrored in a GL buffer that is used as
+ * a ring as well: pushing a point only uploads the new segment and the whole history is drawn with a single call
+ * whatever its age, memory and per-frame cost are bounded by the capacity.
+ */
+struct LineRing
+{
+  explicit LineRing(size_t capacity);
+
+  /** Maximum number of points kept */
+  inline size_t capacity() const noexcept { return points_.capacity(); }
+
+  /** Points currently in the history, the oldest first */
+  inline const RingBuffer<Vector3> & points() const noexcept { return points_; }
+
+  /** Append a point, drops the oldest one if the ring is full */
+  void push(const Vector3 & point);
+
+  /** Remove every point */
+  void clear() noexcept;
+
+  /** Draw the line with \p shader which must be setup by the caller (color, width, transformation...) */
+  void draw(Shaders::LineGL3D & shader);
+
+private:
+  RingBuffer<Vector3> points_;
+  /** Number of points ever pushed, segment k joins points k and k + 1 and lives in slot k % slots() */
+  uint64_t pushed_ = 0;
+  /** Number of the newest segments that have not been uploaded yet */
+  size_t dirty_ = 0;
+  /** Number of segment slots allocated in the GL buffer */
+  size_t allocated_ = 0;
+  std::vector<LineVertex> staging_;
+  std::vector<UnsignedInt> indices_;
+  GL::Buffer vertexBuffer_;
+  GL::Buffer indexBuffer_;
+  GL::Mesh mesh_;
+
+  inline size_t slots() const noexcept { return capacity() - 1; }
+
+  inline size_t segments() const noexcept { return points_.size() > 1 ? points_.size() - 1 : 0; }
+
+  void upload();
+};
+
+/** \ref LineRing along with coarser versions of the same history used when its segments get smaller than a pixel
+ *
+ * Level i > 0 keeps two points per block of 8^i points: the first point of the block and the point furthest away from
+ * the block's chord so that spikes survive the decimation. Levels are updated incrementally as points are pushed and
+ * their rings cover the same time span as the full resolution line.
+ */
+struct LineLod
+{
+  explicit LineLod(size_t capacity);
+
+  /** Maximum number of points kept */
+  inline size_t capacity() const noexcept { return full_.capacity(); }
+
+  /** Points currently in the history at full resolution, the oldest first */
+  inline const RingBuffer<Vector3> & points() const noexcept { return full_.points(); }
+
+  /** Append a point */
+  void push(const Vector3 & point);
+
+  /** Remove every point */
+  void clear() noexcept;
+
+  /** Coarsest level whose segments are (on average) shorter than \p tolerance */
+  size_t level(float tolerance) const noexcept;
+
+  /** Number of full resolution points represented by a point of \p level */
+  static size_t decimation(size_t level) noexcept;
+
+  /** Draw \p level with \p shader which must be setup by the caller
+   *
+   * Points pushed since the last block of that level was completed are not part of the level, they are returned by
+   * \ref tail so the caller can draw them
+   */
+  void draw(Shaders::LineGL3D & shader, size_t level);
+
+  /** Points that \p level does not cover yet, the first one is the last point of the level (if any) */
+  const std::vector<Vector3> & tail(size_t level);
+
+private:
+  struct Level
+  {
+    Level(size_t block, size_t capacity) : block(block), line(capacity) {}
+    size_t block;
+    LineRing line;
+    /** Points of the block being built */
+    std::vector<Vector3> pending;
+  };
+  LineRing full_;
+  std::vector<Level> levels_;
+  /** Sum of the length of the full resolution segments */
+  double length_ = 0.0;
+  std::vector<Vector3> tail_;
+
+  static size_t levelCapacity(size_t capacity, size_t block) noexcept;
+};
+
+} // namespace mc_rtc::magnum
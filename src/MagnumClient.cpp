@@ -14,9 +14,118 @@
 #include "widgets/Visual.h"
 #include "widgets/XYTheta.h"
 
+#include <nanomsg/nn.h>
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  define poll WSAPoll
+#else
+#  include <poll.h>
+#endif
+
 namespace mc_rtc::magnum
 {
 
+MagnumClient::~MagnumClient()
+{
+  stop();
+}
+
+void MagnumClient::start(std::function<void()> notify)
+{
+  stop();
+  notify_ = std::move(notify);
+  running_ = true;
+  ingest_ = std::thread([this]() { ingest(); });
+}
+
+void MagnumClient::stop()
+{
+  running_ = false;
+  if(ingest_.joinable()) { ingest_.join(); }
+}
+
+bool MagnumClient::update()
+{
+  if(!snapshots_.consume()) { return false; }
+  handle_gui_state(std::move(snapshots_.front().state));
+  return true;
+}
+
+namespace
+{
+
+/** Receive one message into \p buffer without blocking
+ *
+ * \returns The size of the message, 0 if no message was available or it did not fit in the buffer
+ */
+size_t receive(int socket, std::vector<char> & buffer)
+{
+  auto recv = nn_recv(socket, buffer.data(), buffer.size(), NN_DONTWAIT);
+  if(recv < 0)
+  {
+    if(nn_errno() != EAGAIN) { mc_rtc::log::error("MagnumClient failed to receive with errno: {}", nn_errno()); }
+    return 0;
+  }
+  if(static_cast<size_t>(recv) > buffer.size())
+  {
+    mc_rtc::log::warning("Receive buffer was too small to receive the latest state message, will resize for next time");
+    buffer.resize(2 * static_cast<size_t>(recv));
+    return 0;
+  }
+  return static_cast<size_t>(recv);
+}
+
+} // namespace
+
+void MagnumClient::ingest()
+{
+  std::vector<char> buffer(65536);
+  std::vector<char> next(65536);
+  while(running_)
+  {
+    int fd = receiveFd();
+    if(fd < 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    pollfd pfd{fd, POLLIN, 0};
+    if(poll(&pfd, 1, 100) <= 0 || !(pfd.revents & POLLIN))
+    {
+      /* Remind the render thread that a state is waiting */
+      if(snapshots_.pending()) { notify_(); }
+      continue;
+    }
+    size_t size = receive(sub_socket_, buffer);
+    if(size == 0) { continue; }
+    received_++;
+    if(coalesce_)
+    {
+      /* Every GUI message holds the full state, only the newest one is worth decoding */
+      while(size_t next_size = receive(sub_socket_, next))
+      {
+        std::swap(buffer, next);
+        size = next_size;
+        received_++;
+        dropped_++;
+      }
+    }
+    snapshots_.back().state = mc_rtc::Configuration::fromMessagePack(buffer.data(), size);
+    if(snapshots_.publish()) { dropped_++; }
+    notify_();
+  }
+}
+
+int MagnumClient::receiveFd() const noexcept
+{
+  if(sub_socket_ < 0) { return -1; }
+  int fd = -1;
+  size_t fd_size = sizeof(fd);
+  if(nn_getsockopt(sub_socket_, NN_SOL_SOCKET, NN_RCVFD, &fd, &fd_size) < 0) { return -1; }
+  return fd;
+}
+
 InteractiveMarkerPtr MagnumClient::make_marker(const sva::PTransformd & pose, ControlAxis mask)
 {
   return std::make_unique<InteractiveMarkerImpl>(gui_.camera(), pose, mask);
@@ -1,8 +1,12 @@
 #pragma once
 
 #include "mc_rtc-imgui/Client.h"
+#include "TripleBuffer.h"
 #include "widgets/details/InteractiveMarker.h"
 
+#include <functional>
+#include <thread>
+
 namespace mc_rtc::magnum
 {
 
@@ -15,12 +19,53 @@ struct MagnumClient : public mc_rtc::imgui::Client
 {
   MagnumClient(McRtcGui & gui) : mc_rtc::imgui::Client(), gui_(gui) {}
 
+  ~MagnumClient() override;
+
+  /** Start receiving and decoding messages in a background thread
+   *
+   * \param notify Called from the background thread whenever a new state is ready or still waiting to be consumed
+   */
+  void start(std::function<void()> notify);
+
+  /** Stop the background thread */
+  void stop();
+
+  /** Apply the latest state received by the background thread, returns true if there was a new state */
+  bool update();
+
+  /** When true (default) the background thread drains all pending messages and only decodes the newest one */
+  inline void coalesce(bool coalesce) noexcept { coalesce_ = coalesce; }
+
+  /** Number of messages received since the client started */
+  inline uint64_t receivedMessages() const noexcept { return received_; }
+
+  /** Number of messages that were received but never applied because a newer one was available */
+  inline uint64_t droppedMessages() const noexcept { return dropped_; }
+
+  /** File descriptor that becomes readable when a message is available, -1 if the client is not connected */
+  int receiveFd() const noexcept;
+
   InteractiveMarkerPtr make_marker(const sva::PTransformd & pose = sva::PTransformd::Identity(),
                                    ControlAxis mask = ControlAxis::NONE) override;
 
 private:
   McRtcGui & gui_;
 
+  /** State decoded by the background thread */
+  struct Snapshot
+  {
+    mc_rtc::Configuration state;
+  };
+  TripleBuffer<Snapshot> snapshots_;
+  std::function<void()> notify_;
+  std::atomic<bool> running_{false};
+  std::atomic<bool> coalesce_{true};
+  std::atomic<uint64_t> received_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::thread ingest_;
+
+  void ingest();
+
   void point3d(const ElementId & id,
                const ElementId & requestId,
                bool ro,
@@ -1,14 +1,12 @@
 #include "McRtcGui.h"
 
-#include <Corrade/Utility/ConfigurationGroup.h>
-#include <Magnum/MeshTools/Transform.h>
-#include <Magnum/Primitives/Axis.h>
+#include "Cache.h"
+
 #include <Magnum/Primitives/Cone.h>
 #include <Magnum/Primitives/Cube.h>
 #include <Magnum/Primitives/Cylinder.h>
 #include <Magnum/Primitives/Grid.h>
 #include <Magnum/Primitives/Icosphere.h>
-#include <Magnum/Primitives/Line.h>
 
 #include "assets/Roboto_Bold_ttf.h"
 #include "assets/Roboto_Regular_ttf.h"
@@ -16,27 +14,36 @@
 #include "implot.h"
 
 #include <boost/program_options.hpp>
+
+#include <algorithm>
 namespace po = boost::program_options;
 
+#if !defined(CORRADE_TARGET_ANDROID) && !defined(CORRADE_TARGET_EMSCRIPTEN)
+#  define MC_RTC_MAGNUM_HAS_GLFW
+#  include <GLFW/glfw3.h>
+#endif
+
 namespace mc_rtc::magnum
 {
 
 struct Grid : public SceneGraph::Drawable3D
 {
-  Grid(Object3D & object, SceneGraph::DrawableGroup3D & drawables) : SceneGraph::Drawable3D(object, &drawables)
+  Grid(Object3D & object, SceneGraph::DrawableGroup3D & drawables, Shaders::FlatGL3D & shader)
+  : SceneGraph::Drawable3D(object, &drawables), shader_(shader)
   {
     object.scale({5.0, 5.0, 5.0});
-    shader_.setColor(0x000000ff_rgbaf);
     mesh_ = MeshTools::compile(Primitives::grid3DWireframe({9, 9}));
   }
 
   void draw(const Matrix4 & transformation, SceneGraph::Camera3D & camera) override
   {
-    shader_.setTransformationProjectionMatrix(camera.projectionMatrix() * transformation).draw(mesh_);
+    shader_.setColor(0x000000ff_rgbaf)
+        .setTransformationProjectionMatrix(camera.projectionMatrix() * transformation)
+        .draw(mesh_);
   }
 
 private:
-  Shaders::FlatGL3D shader_;
+  Shaders::FlatGL3D & shader_;
   GL::Mesh mesh_;
 };
 
@@ -49,16 +56,42 @@ McRtcGui::McRtcGui(const Arguments & arguments)
 {
   {
     std::string host;
+    bool continuous = false;
+    bool no_coalesce = false;
+    bool no_ubo = false;
+    bool no_mesh_cache = false;
+    bool optimize_meshes = false;
+    bool no_lods = false;
+    float upload_budget = uploadBudget_.count();
+    size_t vram_budget = vramBudget_ >> 20;
     po::options_description desc("mc-rtc-magnum options");
     // clang-format off
     desc.add_options()
       ("help", "Show this help message")
-      ("tcp", po::value<std::string>(&host), "Connect to the given host with TCP");
+      ("tcp", po::value<std::string>(&host), "Connect to the given host with TCP")
+      ("continuous", po::bool_switch(&continuous), "Render continuously instead of only when something changed")
+      ("no-coalesce", po::bool_switch(&no_coalesce), "Decode every received message instead of only the newest one")
+      ("no-uniform-buffers", po::bool_switch(&no_ubo), "Do not use uniform buffers to draw imported meshes")
+      ("no-mesh-cache", po::bool_switch(&no_mesh_cache), "Always import meshes from their source files")
+      ("optimize-meshes", po::bool_switch(&optimize_meshes), "Weld, reorder and quantize imported meshes")
+      ("no-lods", po::bool_switch(&no_lods), "Do not generate levels of detail for imported meshes")
+      ("frame-budget", po::value<float>(&frameBudget_), "Frame time above which distant robots are simplified (ms)")
+      ("vram-budget", po::value<size_t>(&vram_budget), "Evict unused imported meshes above this GPU memory (MB)")
+      ("upload-budget", po::value<float>(&upload_budget), "Time spent uploading meshes and textures per frame (ms)")
+      ("stats", po::bool_switch(&showStats_), "Show the statistics window (toggle with F3)");
     // clang-format on
     po::variables_map vm;
     po::store(po::command_line_parser(arguments.argc, arguments.argv).options(desc).run(), vm);
     po::notify(vm);
     if(vm.count("help")) { std::cout << desc << "\n"; }
+    onDemand_ = !continuous;
+    uploadBudget_ = UploadQueue::Budget{upload_budget};
+    vramBudget_ = vram_budget << 20;
+    if(!no_mesh_cache && !cacheDirectory().empty()) { importOptions_.cache = cacheDirectory() / "meshes"; }
+    importOptions_.lods = !no_lods;
+    importOptions_.optimize = optimize_meshes;
+    client_.coalesce(!no_coalesce);
+    if(!no_ubo && UniformBatch::supported()) { uniformBatch_.emplace(shaders_); }
     if(vm.count("tcp")) { client_.connect(fmt::format("tcp://{}:4242", host), fmt::format("tcp://{}:4343", host)); }
   }
   {
@@ -90,13 +123,36 @@ McRtcGui::McRtcGui(const Arguments & arguments)
                                  GL::Renderer::BlendFunction::OneMinusSourceAlpha);
   Color4ub bg = 0xd3d7cfff_rgba;
   GL::Renderer::setClearColor(bg.toSrgbAlpha());
-  colorShader_.setAmbientColor(0x11111100_rgbaf).setSpecularColor(0xffffff00_rgbaf).setShininess(80.0f);
-  textureShader_.setAmbientColor(0x11111100_rgbaf).setSpecularColor(0xffffff00_rgbaf).setShininess(80.0f);
 
-  /** Plugin */
-  importer_ = manager_.loadAndInstantiate("AssimpImporter");
-  importer_->configuration().setValue("ImportColladaIgnoreUpDirection", true);
-  importer_->configuration().group("postprocess")->setValue("PreTransformVertices", true);
+  /** Start compiling every shader, they are linked in parallel while the first frames only show the UI */
+  {
+    auto setupPhong = [](Shaders::PhongGL & shader)
+    { shader.setAmbientColor(0x11111100_rgbaf).setSpecularColor(0xffffff00_rgbaf).setShininess(80.0f); };
+    shaders_.compile(colorShader_, Shaders::PhongGL::Configuration{}, setupPhong);
+    shaders_.compile(textureShader_,
+                     Shaders::PhongGL::Configuration{}.setFlags(Shaders::PhongGL::Flag::DiffuseTexture), setupPhong);
+    shaders_.compile(shader_, Shaders::PhongGL::Configuration{});
+    shaders_.compile(instancedShader_,
+                     Shaders::PhongGL::Configuration{}.setFlags(Shaders::PhongGL::Flag::InstancedTransformation
+                                                                | Shaders::PhongGL::Flag::VertexColor),
+                     [](Shaders::PhongGL & shader) {
+                       shader.setAmbientColor({Color3{0.3f}, 0.0f})
+                           .setSpecularColor(0xffffff00_rgbaf)
+                           .setShininess(80.0f);
+                     });
+  }
+
+  /** Compile the shader variants used by widgets upfront so that new elements never compile shaders */
+  shaders_.prepare<Shaders::FlatGL3D>();
+  shaders_.prepare<Shaders::LineGL3D>();
+  shaders_.prepare<Shaders::PhongGL>(Shaders::PhongGL::Flag::VertexColor | Shaders::PhongGL::Flag::DoubleSided);
+  shaders_.prepare<Shaders::MeshVisualizerGL3D>(Shaders::MeshVisualizerGL3D::Flag::Wireframe);
+
+  /** Meshes are imported in the background, the workers wake the main loop when they are done */
+  {
+    size_t threads = std::max(std::min(std::thread::hardware_concurrency(), 5u), 2u) - 1;
+    importer_.emplace(threads, [this]() { wake(); }, importOptions_);
+  }
 
   /** Camera setup */
   {
@@ -105,12 +161,58 @@ McRtcGui::McRtcGui(const Arguments & arguments)
 
   /** Grid */
   {
-    new Grid{*new Object3D{&scene_}, drawables_};
+    new Grid{*new Object3D{&scene_}, drawables_, shaders_.get<Shaders::FlatGL3D>()};
   }
 
-  axisMesh_ = MeshTools::compile(Primitives::axis3D());
   cubeMesh_ = MeshTools::compile(Primitives::cubeSolid());
   sphereMesh_ = MeshTools::compile(Primitives::icosphereSolid(2));
+  cubeInstances_.emplace(Primitives::cubeSolid());
+  sphereInstances_.emplace(Primitives::icosphereSolid(2));
+  /* Unit arrow parts: radius 1 and length 2 along Y, scaled per arrow */
+  auto shaft = Primitives::cylinderSolid(16, 32, 1.0f, Primitives::CylinderFlag::CapEnds);
+  auto head = Primitives::coneSolid(64, 128, 1.0f, Primitives::ConeFlag::CapEnd);
+  arrowShaftMesh_ = MeshTools::compile(shaft);
+  arrowHeadMesh_ = MeshTools::compile(head);
+  arrowShaftInstances_.emplace(shaft);
+  arrowHeadInstances_.emplace(head);
+}
+
+int McRtcGui::run()
+{
+  client_.start(
+      [this]()
+      {
+        auto now = std::chrono::steady_clock::now();
+        if(idle_ && now - lastWake_ < idlePeriod_) { return; }
+        lastWake_ = now;
+        wake();
+      });
+#ifdef MC_RTC_MAGNUM_HAS_GLFW
+  while(mainLoopIteration())
+  {
+    if(wake_.exchange(false)) { redraw(); }
+  }
+  client_.stop();
+  return 0;
+#else
+  int ret = exec();
+  client_.stop();
+  return ret;
+#endif
+}
+
+void McRtcGui::wake() noexcept
+{
+  wake_ = true;
+#ifdef MC_RTC_MAGNUM_HAS_GLFW
+  glfwPostEmptyEvent();
+#endif
+}
+
+void McRtcGui::inputEvent()
+{
+  pendingFrames_ = 3;
+  redraw();
 }
 
 auto McRtcGui::importData(const std::string & path) -> ImportedMesh &
@@ -119,75 +221,119 @@ auto McRtcGui::importData(const std::string & path) -> ImportedMesh &
   // FIXME Check the file hash to detect online changes
   if(it != importedData_.end()) { return it->second; }
   auto & out = importedData_[path];
-  if(!importer_->openFile(path)) { return out; }
-  out.textures_ = Containers::Array<Containers::Optional<GL::Texture2D>>{importer_->textureCount()};
-  for(UnsignedInt i = 0; i < importer_->textureCount(); ++i)
-  {
-    Containers::Optional<Trade::TextureData> textureData = importer_->texture(i);
-    if(!textureData || textureData->type() != Trade::TextureType::Texture2D)
-    {
-      Warning{} << "Cannot load texture properties, skipping";
-      continue;
-    }
+  out.job_ = importer_->submit(path);
+  importing_.push_back(&out);
+  return out;
+}
 
-    Containers::Optional<Trade::ImageData2D> imageData = importer_->image2D(textureData->image());
-    GL::TextureFormat format;
-    if(imageData && imageData->format() == PixelFormat::RGB8Unorm)
-      format = GL::TextureFormat::RGB8;
-    else if(imageData && imageData->format() == PixelFormat::RGBA8Unorm)
-      format = GL::TextureFormat::RGBA8;
-    else
+void McRtcGui::updateImports()
+{
+  for(size_t i = 0; i < importing_.size();)
+  {
+    auto & out = *importing_[i];
+    if(!out.job_->done)
     {
-      Warning{} << "Cannot load texture image, skipping";
+      ++i;
       continue;
     }
+    upload(out, out.job_);
+    out.job_.reset();
+    importing_.erase(importing_.begin() + static_cast<std::ptrdiff_t>(i));
+  }
+}
 
-    /* Configure the texture */
-    GL::Texture2D texture;
-    texture.setMagnificationFilter(textureData->magnificationFilter())
-        .setMinificationFilter(textureData->minificationFilter(), textureData->mipmapFilter())
-        .setWrapping(textureData->wrapping().xy())
-        .setStorage(Math::log2(imageData->size().max()) + 1, format, imageData->size())
-        .setSubImage(0, {}, *imageData)
-        .generateMipmap();
-
-    out.textures_[i] = std::move(texture);
+void McRtcGui::evictImports()
+{
+  if(vramBudget_ == 0) { return; }
+  size_t total = 0;
+  std::vector<std::unordered_map<std::string, ImportedMesh>::iterator> unused;
+  for(auto it = importedData_.begin(); it != importedData_.end(); ++it)
+  {
+    const auto & data = it->second;
+    total += data.gpuBytes_;
+    /* Meshes still importing or uploading are referenced by the import pool and the upload queue */
+    if(data.users_ == 0 && data.ready_) { unused.push_back(it); }
   }
-  /* Load all materials. Materials that fail to load will be NullOpt. The
-   data will be stored directly in objects later, so save them only
-   temporarily. */
-  out.materials_ = Containers::Array<Containers::Optional<Trade::PhongMaterialData>>{importer_->materialCount()};
-  for(UnsignedInt i = 0; i != importer_->materialCount(); ++i)
+  if(total <= vramBudget_) { return; }
+  std::sort(unused.begin(), unused.end(),
+            [](const auto & a, const auto & b) { return a->second.released_ < b->second.released_; });
+  for(auto & it : unused)
   {
-    Containers::Optional<Trade::MaterialData> materialData = importer_->material(i);
-    if(!materialData || !(materialData->types() & Trade::MaterialType::Phong))
-    {
-      Warning{} << "Cannot load material, skipping";
-      continue;
-    }
-
-    out.materials_[i] = std::move(static_cast<Trade::PhongMaterialData &>(*materialData));
+    if(total <= vramBudget_) { break; }
+    total -= it->second.gpuBytes_;
+    importedData_.erase(it);
+    evicted_++;
   }
-  /* Load all meshes. Meshes that fail to load will be NullOpt. */
-  out.meshes_ = Containers::Array<Containers::Optional<GL::Mesh>>{importer_->meshCount()};
-  for(UnsignedInt i = 0; i != importer_->meshCount(); ++i)
+}
+
+void McRtcGui::upload(ImportedMesh & out, const ImportJobPtr & job)
+{
+  auto & data = job->data;
+  out.textures_ = Containers::Array<Containers::Optional<GL::Texture2D>>{data.textures.size()};
+  out.meshes_ = Containers::Array<Containers::Optional<GL::Mesh>>{data.meshes.size()};
+  out.materials_ = std::move(data.materials);
+  out.bounds_ = std::move(data.bounds);
+  out.decode_ = std::move(data.decode);
+  out.lods_ = std::move(data.lods);
+  out.gpuBytes_ = 0;
+  out.scene_ = std::move(data.scene);
+  /* The batched meshes are merged once, the views are shared by every Mesh using this import */
+  auto ready = [this, &out, job]()
   {
-    Containers::Optional<Trade::MeshData> meshData = importer_->mesh(i);
-    if(!meshData || !meshData->hasAttribute(Trade::MeshAttribute::Normal))
+    if(uniformBatch_)
     {
-      Warning{} << "Cannot load mesh " << i << " in skipping " << path.c_str();
-      continue;
+      out.merged_.emplace();
+      out.views_ = Containers::Array<GL::MeshView *>{ValueInit, job->data.meshes.size()};
+      for(size_t i = 0; i < job->data.meshes.size(); ++i)
+      {
+        if(job->data.meshes[i]) { out.views_[i] = out.merged_->add(*job->data.meshes[i]); }
+      }
+      out.merged_->build();
+      out.gpuBytes_ += out.merged_->bytes();
     }
-
-    /* Compile the mesh */
-    out.meshes_[i] = MeshTools::compile(*meshData);
+    out.ready_ = true;
+  };
+  /* The GL objects are created by the upload queue, the mesh is ready once they all exist */
+  auto uploaded = [&out, ready]()
+  {
+    if(--out.uploads_ == 0) { ready(); }
+  };
+  for(size_t i = 0; i < data.textures.size(); ++i)
+  {
+    if(!data.textures[i]) { continue; }
+    out.uploads_++;
+    /* Mipmaps add a third of the base level */
+    out.gpuBytes_ += data.textures[i]->image.data().size() * 4 / 3;
+    uploads_.push(data.textures[i]->image.data().size(),
+                  [&out, job, i, uploaded]()
+                  {
+                    const auto & t = *job->data.textures[i];
+                    GL::TextureFormat format =
+                        t.image.format() == PixelFormat::RGB8Unorm ? GL::TextureFormat::RGB8 : GL::TextureFormat::RGBA8;
+                    GL::Texture2D texture;
+                    texture.setMagnificationFilter(t.magnificationFilter)
+                        .setMinificationFilter(t.minificationFilter, t.mipmapFilter)
+                        .setWrapping(t.wrapping)
+                        .setStorage(Math::log2(t.image.size().max()) + 1, format, t.image.size())
+                        .setSubImage(0, {}, t.image)
+                        .generateMipmap();
+                    out.textures_[i] = std::move(texture);
+                    uploaded();
+                  });
   }
-  if(importer_->defaultScene() != -1)
+  for(size_t i = 0; i < data.meshes.size(); ++i)
   {
-    out.scene_ = importer_->scene(importer_->defaultScene());
-    if(!out.scene_) { Error{} << "Cannot load scene from " << path.c_str(); }
+    if(!data.meshes[i]) { continue; }
+    out.uploads_++;
+    out.gpuBytes_ += data.meshes[i]->vertexData().size() + data.meshes[i]->indexData().size();
+    uploads_.push(data.meshes[i]->vertexData().size() + data.meshes[i]->indexData().size(),
+                  [&out, job, i, uploaded]()
+                  {
+                    out.meshes_[i] = MeshTools::compile(*job->data.meshes[i]);
+                    uploaded();
+                  });
   }
-  return out;
+  if(out.uploads_ == 0) { ready(); }
 }
 
 std::shared_ptr<Mesh> McRtcGui::loadMesh(const std::string & path,
@@ -197,31 +343,44 @@ std::shared_ptr<Mesh> McRtcGui::loadMesh(const std::string & path,
 {
   auto & data = importData(path);
   return std::make_shared<Mesh>(parent ? parent : &scene_, group ? group : &drawables_, data, colorShader_,
-                                textureShader_, color);
+                                textureShader_, color, uniformBatch_ ? &*uniformBatch_ : nullptr,
+                                &*cubeInstances_);
 }
 
 void McRtcGui::drawEvent()
 {
+  auto start = std::chrono::steady_clock::now();
   GL::defaultFramebuffer.clear(GL::FramebufferClear::Color | GL::FramebufferClear::Depth);
   GL::Renderer::enable(GL::Renderer::Feature::Blending);
 
   client_.update();
+  updateImports();
+  bool uploading = uploads_.run(uploadBudget_);
+  evictImports();
 
   imgui_.newFrame();
   ImGuizmo::BeginFrame();
 
-  drawFrame({}, 0.1);
-  std::vector<std::pair<std::reference_wrapper<SceneGraph::Drawable3D>, Matrix4>> drawableTransformations =
-      camera_->camera()->drawableTransformations(drawables_);
-
-  std::sort(drawableTransformations.begin(), drawableTransformations.end(),
-            [](const std::pair<std::reference_wrapper<SceneGraph::Drawable3D>, Matrix4> & a,
-               const std::pair<std::reference_wrapper<SceneGraph::Drawable3D>, Matrix4> & b)
-            { return a.second.translation().z() < b.second.translation().z(); });
-
-  camera_->camera()->draw(drawableTransformations);
-  camera_->camera()->draw(polyhedrons_);
-  client_.draw3D();
+  /* Shaders are compiled in parallel at startup, the 3D scene is only drawn once they are all linked */
+  bool shadersReady = shaders_.update();
+  if(shadersReady)
+  {
+    drawFrame({}, 0.1);
+    auto & camera = *camera_->camera();
+    queue_.clear(camera);
+    queue_.submit(drawables_, camera);
+    queue_.submit(polyhedrons_, camera);
+    queue_.drawOpaque(camera);
+    client_.draw3D();
+    lines_.draw(camera);
+    cubeInstances_->draw(instancedShader_, camera.projectionMatrix());
+    sphereInstances_->draw(instancedShader_, camera.projectionMatrix());
+    arrowShaftInstances_->draw(instancedShader_, camera.projectionMatrix());
+    arrowHeadInstances_->draw(instancedShader_, camera.projectionMatrix());
+    axes_.draw(camera.projectionMatrix() * camera.cameraMatrix());
+    if(uniformBatch_) { uniformBatch_->draw(camera.projectionMatrix()); }
+    queue_.drawTransparent(camera);
+  }
 
   /* Enable text input, if needed */
   if(ImGui::GetIO().WantTextInput && !isTextInputActive()) { startTextInput(); }
@@ -232,6 +391,7 @@ void McRtcGui::drawEvent()
   ImGuizmo::SetRect(0, 0, io.DisplaySize.x, io.DisplaySize.y);
 
   client_.draw2D({static_cast<float>(windowSize().x()), static_cast<float>(windowSize().y())});
+  if(showStats_) { drawStats(); }
 
   /* Update application cursor */
   imgui_.updateApplicationCursor(*this);
@@ -250,12 +410,54 @@ void McRtcGui::drawEvent()
   GL::Renderer::enable(GL::Renderer::Feature::FaceCulling);
   GL::Renderer::disable(GL::Renderer::Feature::ScissorTest);
 
+  frameTime_ = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
   swapBuffers();
-  redraw();
+
+#ifdef MC_RTC_MAGNUM_HAS_GLFW
+  idle_ = !glfwGetWindowAttrib(window(), GLFW_FOCUSED) || glfwGetWindowAttrib(window(), GLFW_ICONIFIED);
+#endif
+  bool interacting = ImGuizmo::IsUsing() || ImGui::IsAnyItemActive() || ImGui::GetIO().WantTextInput;
+  if(!onDemand_ || pendingFrames_ > 0 || interacting || !shadersReady || uploading) { redraw(); }
+  if(pendingFrames_ > 0) { --pendingFrames_; }
+}
+
+void McRtcGui::drawStats()
+{
+  ImGui::SetNextWindowPos({10.0f, 10.0f}, ImGuiCond_FirstUseEver);
+  ImGui::Begin("Statistics", &showStats_, ImGuiWindowFlags_AlwaysAutoResize);
+  ImGui::Text("Frame time: %.2f ms", frameTime_);
+  ImGui::Text("Drawables: %zu drawn, %zu culled", queue_.drawn(), queue_.culled());
+  ImGui::Text("Instanced primitives: %zu", cubeInstances_->drawn() + sphereInstances_->drawn());
+  ImGui::Text("Instanced arrows: %zu", arrowShaftInstances_->drawn() + arrowHeadInstances_->drawn());
+  ImGui::Text("Instanced frames: %zu", axes_.drawn());
+  if(uniformBatch_)
+  {
+    ImGui::Text("Uniform buffer draws: %zu in %zu calls", uniformBatch_->drawn(), uniformBatch_->calls());
+  }
+  ImGui::Text("Line segments: %zu", lines_.drawn());
+  ImGui::Text("Meshes importing: %zu", importing_.size());
+  ImGui::Text("Uploads pending: %zu (%.1f MB)", uploads_.pending(), static_cast<double>(uploads_.bytes()) / 1e6);
+  {
+    size_t bytes = 0;
+    size_t unused = 0;
+    for(const auto & d : importedData_)
+    {
+      bytes += d.second.gpuBytes_;
+      if(d.second.users_ == 0) { unused++; }
+    }
+    ImGui::Text("Imported meshes: %zu (%zu unused, %.1f MB)", importedData_.size(), unused,
+                static_cast<double>(bytes) / 1e6);
+    ImGui::Text("Imported meshes evicted: %zu", evicted_);
+  }
+  ImGui::Text("Shared shader variants: %zu (%zu compiling)", shaders_.size(), shaders_.pending());
+  ImGui::Text("Messages received: %lu", static_cast<unsigned long>(client_.receivedMessages()));
+  ImGui::Text("Messages dropped: %lu", static_cast<unsigned long>(client_.droppedMessages()));
+  ImGui::End();
 }
 
 void McRtcGui::viewportEvent(ViewportEvent & event)
 {
+  inputEvent();
   GL::defaultFramebuffer.setViewport({{}, event.framebufferSize()});
 
   imgui_.relayout(Vector2{event.windowSize()} / event.dpiScaling(), event.windowSize(), event.framebufferSize());
@@ -265,34 +467,45 @@ void McRtcGui::viewportEvent(ViewportEvent & event)
 
 void McRtcGui::keyPressEvent(KeyEvent & event)
 {
+  inputEvent();
   if(imgui_.handleKeyPressEvent(event)) { return; }
+  if(event.key() == KeyEvent::Key::F3)
+  {
+    showStats_ = !showStats_;
+    return;
+  }
   camera_->keyPressEvent(*this, event);
 }
 
 void McRtcGui::keyReleaseEvent(KeyEvent & event)
 {
+  inputEvent();
   if(imgui_.handleKeyReleaseEvent(event)) return;
 }
 
 void McRtcGui::mousePressEvent(MouseEvent & event)
 {
+  inputEvent();
   if(imgui_.handleMousePressEvent(event)) { return; }
   camera_->mousePressEvent(*this, event);
 }
 
 void McRtcGui::mouseReleaseEvent(MouseEvent & event)
 {
+  inputEvent();
   if(imgui_.handleMouseReleaseEvent(event)) { return; }
 }
 
 void McRtcGui::mouseMoveEvent(MouseMoveEvent & event)
 {
+  inputEvent();
   if(imgui_.handleMouseMoveEvent(event)) { return; }
   camera_->mouseMoveEvent(*this, event);
 }
 
 void McRtcGui::mouseScrollEvent(MouseScrollEvent & event)
 {
+  inputEvent();
   if(imgui_.handleMouseScrollEvent(event))
   {
     /* Prevent scrolling the page */
@@ -304,6 +517,7 @@ void McRtcGui::mouseScrollEvent(MouseScrollEvent & event)
 
 void McRtcGui::textInputEvent(TextInputEvent & event)
 {
+  inputEvent();
   if(imgui_.handleTextInputEvent(event)) return;
 }
 
@@ -315,7 +529,7 @@ BoxPtr McRtcGui::makeBox(Vector3 center,
                          SceneGraph::DrawableGroup3D * group)
 {
   return std::make_shared<Box>(parent ? parent : &scene_, group ? group : &drawables_, shader_, cubeMesh_,
-                               Matrix4::from(ori, center), size, color);
+                               *cubeInstances_, Matrix4::from(ori, center), size, color);
 }
 
 SpherePtr McRtcGui::makeSphere(Vector3 center,
@@ -324,8 +538,8 @@ SpherePtr McRtcGui::makeSphere(Vector3 center,
                                Object3D * parent,
                                SceneGraph::DrawableGroup3D * group)
 {
-  return std::make_shared<Sphere>(parent ? parent : &scene_, group ? group : &drawables_, shader_, sphereMesh_, center,
-                                  radius, color);
+  return std::make_shared<Sphere>(parent ? parent : &scene_, group ? group : &drawables_, shader_, sphereMesh_,
+                                  *sphereInstances_, center, radius, color);
 }
 
 EllipsoidPtr McRtcGui::makeEllipsoid(Vector3 center,
@@ -336,19 +550,17 @@ EllipsoidPtr McRtcGui::makeEllipsoid(Vector3 center,
                                      SceneGraph::DrawableGroup3D * group)
 {
   return std::make_shared<Ellipsoid>(parent ? parent : &scene_, group ? group : &drawables_, shader_, sphereMesh_,
-                                     Matrix4::from(ori, center), size, color);
+                                     *sphereInstances_, Matrix4::from(ori, center), size, color);
 }
 
 PolyhedronPtr McRtcGui::makePolyhedron()
 {
-  return std::make_shared<PolyhedronDrawable>(&scene_, &polyhedrons_);
+  return std::make_shared<PolyhedronDrawable>(&scene_, &polyhedrons_, shaders_);
 }
 
-void McRtcGui::drawLine(Vector3 start, Vector3 end, Color4 color, float /*thickness*/)
+void McRtcGui::drawLine(Vector3 start, Vector3 end, Color4 color, float thickness)
 {
-  // FIXME Write a shader to handle nice line drawing
-  auto lineMesh = MeshTools::compile(Primitives::line3D(start, end));
-  draw(lineMesh, color);
+  lines_.add(start, end, color, thickness);
 }
 
 void McRtcGui::drawArrow(Vector3 start, Vector3 end, float shaft_diam, float head_diam, float head_len, Color4 color)
@@ -364,34 +576,34 @@ void McRtcGui::drawArrow(Vector3 start, Vector3 end, float shaft_diam, float hea
   auto axis = cross(normal, {0.0f, 1.0f, 0.0f});
   if(axis.length() == 0.0f) { axis = {1, 0, 0}; }
   axis = axis.normalized();
+  Matrix4 rotation = Matrix4::rotation(-theta, axis);
+  /* Transparent arrows are drawn immediately, opaque ones are batched and drawn with the other instances */
+  bool opaque = color.a() >= 1.0f;
+  const Matrix4 & cameraMatrix = camera_->camera()->cameraMatrix();
+  auto drawPart = [&](GL::Mesh & mesh, InstancedMesh & instances, const Matrix4 & transform)
+  {
+    if(opaque) { instances.add(cameraMatrix * transform, color); }
+    else { draw(mesh, color, transform); }
+  };
   if(shaft_len != 0 && shaft_diam != 0)
   {
     float r = shaft_diam / 2;
-    auto shaftMesh =
-        MeshTools::compile(Primitives::cylinderSolid(16, 32, 0.5f * shaft_len / r, Primitives::CylinderFlag::CapEnds));
-    draw(shaftMesh, color,
-         Matrix4::translation(start + 0.5f * shaft_len * normal) * Matrix4::rotation(-theta, axis)
-             * Matrix4::scaling({r, r, r}));
+    drawPart(arrowShaftMesh_, *arrowShaftInstances_,
+             Matrix4::translation(start + 0.5f * shaft_len * normal) * rotation
+                 * Matrix4::scaling({r, 0.5f * shaft_len, r}));
   }
   if(head_len != 0 && head_diam != 0)
   {
     float r = head_diam / 2;
-    auto headPrimitive = Primitives::coneSolid(64, 128, 0.5f * head_len / r, Primitives::ConeFlag::CapEnd);
-    MeshTools::transformPointsInPlace(Matrix4::scaling({r, r, r}),
-                                      headPrimitive.mutableAttribute<Vector3>(Trade::MeshAttribute::Position));
-    auto headMesh = MeshTools::compile(headPrimitive);
-    draw(headMesh, color,
-         Matrix4::translation(start + (shaft_len + 0.5f * head_len) * normal) * Matrix4::rotation(-theta, axis));
+    drawPart(arrowHeadMesh_, *arrowHeadInstances_,
+             Matrix4::translation(start + (shaft_len + 0.5f * head_len) * normal) * rotation
+                 * Matrix4::scaling({r, 0.5f * head_len, r}));
   }
 }
 
 void McRtcGui::drawFrame(Matrix4 pos, float scale)
 {
-  auto & camera = *camera_->camera();
-  vertexShader_
-      .setTransformationProjectionMatrix(camera.projectionMatrix() * camera.cameraMatrix() * pos
-                                         * Matrix4::scaling(Vector3{scale}))
-      .draw(axisMesh_);
+  axes_.add(pos * Matrix4::scaling(Vector3{scale}));
 }
 
 void McRtcGui::draw(GL::Mesh & mesh, const Color4 & color, const Matrix4 & worldTransform)
@@ -408,4 +620,12 @@ void McRtcGui::draw(GL::Mesh & mesh, const Color4 & color, const Matrix4 & world
 
 } // namespace mc_rtc::magnum
 
+#ifdef MC_RTC_MAGNUM_HAS_GLFW
+int main(int argc, char ** argv)
+{
+  mc_rtc::magnum::McRtcGui app({argc, argv});
+  return app.run();
+}
+#else
 MAGNUM_APPLICATION_MAIN(mc_rtc::magnum::McRtcGui)
+#endif
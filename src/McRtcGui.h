@@ -6,7 +6,16 @@
 #include "MagnumClient.h"
 
 #include "Camera.h"
+#include "InstancedMesh.h"
+#include "Lines.h"
 #include "Mesh.h"
+#include "RenderQueue.h"
+#include "ShaderCache.h"
+#include "UniformBatch.h"
+#include "UploadQueue.h"
+
+#include <atomic>
+#include <chrono>
 
 namespace mc_rtc::magnum
 {
@@ -15,6 +24,16 @@ struct McRtcGui : public Platform::Application
 {
   explicit McRtcGui(const Arguments & arguments);
 
+  /** Run the main loop
+   *
+   * In on-demand mode a frame is only rendered when new data arrived, an input event happened or an interaction is
+   * still in progress
+   */
+  int run();
+
+  /** Request a new frame, this is safe to call from any thread */
+  void wake() noexcept;
+
   void drawEvent() override;
 
   void viewportEvent(ViewportEvent & event) override;
@@ -55,8 +74,10 @@ struct McRtcGui : public Platform::Application
 
   PolyhedronPtr makePolyhedron();
 
+  /** Show a coordinate frame during this frame, frames are drawn together with a single instanced call */
   void drawFrame(Matrix4 pos, float scale = 0.15);
 
+  /** Draw a line segment during this frame, \p thickness is in pixels */
   void drawLine(Vector3 start, Vector3 end, Color4 color, float thickness = 1.0);
 
   void drawArrow(Vector3 start, Vector3 end, float shaft_diam, float head_diam, float head_len, Color4 color);
@@ -67,31 +88,108 @@ struct McRtcGui : public Platform::Application
 
   inline SceneGraph::DrawableGroup3D & drawables() noexcept { return drawables_; }
 
+  inline RenderQueue & renderQueue() noexcept { return queue_; }
+
+  /** True if the last frame took longer than the frame budget, widgets can then use cheaper representations */
+  inline bool overBudget() const noexcept { return frameBudget_ > 0.0f && frameTime_ > frameBudget_; }
+
+  /** Shaders shared by the drawables and widgets */
+  inline ShaderCache & shaders() noexcept { return shaders_; }
+
 private:
   ImGuiIntegration::Context imgui_{NoCreate};
 
+  /** Declared first so it outlives everything that references its shaders */
+  ShaderCache shaders_;
+
   Scene3D scene_;
   SceneGraph::DrawableGroup3D drawables_;
   SceneGraph::DrawableGroup3D polyhedrons_;
   Containers::Optional<Camera> camera_;
+  RenderQueue queue_;
 
-  PluginManager::Manager<Trade::AbstractImporter> manager_;
-  Containers::Pointer<Trade::AbstractImporter> importer_;
-  Shaders::PhongGL colorShader_;
-  Shaders::PhongGL textureShader_{Shaders::PhongGL::Configuration{}.setFlags(Shaders::PhongGL::Flag::DiffuseTexture)};
+  Containers::Optional<ImportPool> importer_;
+  ImportOptions importOptions_;
+  /** Shaders owned by the GUI are created empty and compiled asynchronously by shaders_ */
+  Shaders::PhongGL colorShader_{NoCreate};
+  Shaders::PhongGL textureShader_{NoCreate};
 
   std::unordered_map<std::string, ImportedMesh> importedData_;
 
+  /** Imports still running in the background */
+  std::vector<ImportedMesh *> importing_;
+
+  /** Get the data for \p mesh, the import is started in the background if needed */
   ImportedMesh & importData(const std::string & mesh);
 
+  /** Upload the imports that are done, called every frame */
+  void updateImports();
+
+  /** Memory budget of the imported meshes (bytes), disabled if zero */
+  size_t vramBudget_ = size_t(512) << 20;
+  /** Number of imported meshes evicted so far */
+  size_t evicted_ = 0;
+
+  /** Evict the least recently used imports that are no longer used until the budget is met, called every frame
+   *
+   * Evicted meshes are reloaded from the \ref MeshCache when they are needed again
+   */
+  void evictImports();
+
+  /** GL uploads of imported meshes and textures */
+  UploadQueue uploads_;
+  /** Time spent running uploads every frame */
+  UploadQueue::Budget uploadBudget_{4.0f};
+
+  /** Queue the creation of the GL objects for the result of \p job in \p out */
+  void upload(ImportedMesh & out, const ImportJobPtr & job);
+
   GL::Mesh cubeMesh_;
   GL::Mesh sphereMesh_;
-  GL::Mesh axisMesh_;
-  Shaders::PhongGL shader_;
-  Shaders::VertexColorGL3D vertexShader_;
+  Shaders::PhongGL shader_{NoCreate};
+  /** Opaque primitives sharing a mesh are drawn with one instanced call per frame */
+  Shaders::PhongGL instancedShader_{NoCreate};
+  Containers::Optional<InstancedMesh> cubeInstances_;
+  Containers::Optional<InstancedMesh> sphereInstances_;
+  /** Unit arrow shaft and head, see \ref drawArrow */
+  GL::Mesh arrowShaftMesh_;
+  GL::Mesh arrowHeadMesh_;
+  Containers::Optional<InstancedMesh> arrowShaftInstances_;
+  Containers::Optional<InstancedMesh> arrowHeadInstances_;
+  /** Frames shown by \ref drawFrame */
+  InstancedAxes axes_{shaders_};
+  /** Opaque imported meshes are drawn through uniform buffers when supported */
+  Containers::Optional<UniformBatch> uniformBatch_;
+  /** Lines drawn with \ref drawLine are batched and drawn once per frame */
+  LineBatch lines_{shaders_};
 
   MagnumClient client_;
 
+  /** Only render frames when something changed */
+  bool onDemand_ = true;
+  /** Number of frames that are still rendered after an input event (ImGui needs a few frames to settle) */
+  int pendingFrames_ = 0;
+  /** True when the window is unfocused or minimized */
+  std::atomic<bool> idle_{false};
+  /** Set when another thread requested a new frame */
+  std::atomic<bool> wake_{false};
+  /** Last time the ingest thread woke the main loop, only accessed from that thread */
+  std::chrono::steady_clock::time_point lastWake_;
+  /** Minimum period between two data-driven frames when the window is idle */
+  static constexpr std::chrono::milliseconds idlePeriod_{250};
+
+  /** Show the statistics window (toggled with F3) */
+  bool showStats_ = false;
+  /** CPU time spent in the last drawEvent() call (ms) */
+  float frameTime_ = 0.0f;
+  /** Frame time above which \ref overBudget is true (ms), disabled if zero */
+  float frameBudget_ = 0.0f;
+
+  /** Request a few frames after an input event */
+  void inputEvent();
+
+  void drawStats();
+
   void draw(GL::Mesh & mesh, const Color4 & color, const Matrix4 & worldTransform = {});
 };
 
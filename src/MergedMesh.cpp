@@ -0,0 +1,66 @@
+#include "MergedMesh.h"
+
+#include <Magnum/MeshTools/Compile.h>
+#include <Magnum/MeshTools/Concatenate.h>
+
+namespace mc_rtc::magnum
+{
+
+namespace
+{
+
+/** Every part is converted to this layout so that they can be concatenated */
+struct Vertex
+{
+  Vector3 position;
+  Vector3 normal;
+};
+
+} // namespace
+
+GL::MeshView * MergedMesh::add(const Trade::MeshData & mesh)
+{
+  if(mesh.primitive() != MeshPrimitive::Triangles || !mesh.hasAttribute(Trade::MeshAttribute::Position)
+     || !mesh.hasAttribute(Trade::MeshAttribute::Normal) || mesh.vertexCount() == 0)
+  {
+    return nullptr;
+  }
+  UnsignedInt count = mesh.isIndexed() ? mesh.indexCount() : mesh.vertexCount();
+  if(count == 0) { return nullptr; }
+
+  /* Quantized positions and normals are unpacked, their decode transformation stays in the drawable */
+  Containers::Array<char> vertexData{NoInit, mesh.vertexCount() * sizeof(Vertex)};
+  auto view = Containers::stridedArrayView(Containers::arrayCast<Vertex>(vertexData));
+  mesh.positions3DInto(view.slice(&Vertex::position));
+  mesh.normalsInto(view.slice(&Vertex::normal));
+  Containers::Array<char> indexData{NoInit, count * sizeof(UnsignedInt)};
+  auto indices = Containers::arrayCast<UnsignedInt>(indexData);
+  if(mesh.isIndexed()) { mesh.indicesInto(indices); }
+  else
+  {
+    for(UnsignedInt i = 0; i < count; ++i) { indices[i] = i; }
+  }
+  Trade::MeshAttributeData positions{Trade::MeshAttribute::Position, view.slice(&Vertex::position)};
+  Trade::MeshAttributeData normals{Trade::MeshAttribute::Normal, view.slice(&Vertex::normal)};
+  parts_.emplace_back(MeshPrimitive::Triangles, std::move(indexData), Trade::MeshIndexData{indices},
+                      std::move(vertexData),
+                      Containers::Array<Trade::MeshAttributeData>{InPlaceInit, {positions, normals}},
+                      mesh.vertexCount());
+
+  /* The concatenated index buffer keeps the parts in order, with their indices offset by the preceding vertices */
+  auto & out = views_.emplace_back(mesh_);
+  out.setCount(static_cast<Int>(count)).setIndexOffset(static_cast<Int>(indexCount_));
+  indexCount_ += count;
+  return &out;
+}
+
+void MergedMesh::build()
+{
+  if(parts_.empty()) { return; }
+  auto merged = MeshTools::concatenate(Containers::arrayView(parts_.data(), parts_.size()));
+  bytes_ = merged.vertexData().size() + merged.indexData().size();
+  mesh_ = MeshTools::compile(merged);
+  parts_ = {};
+}
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Camera.h"
+
+#include <Magnum/GL/Mesh.h>
+#include <Magnum/GL/MeshView.h>
+
+#include <deque>
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+/** Several meshes merged into a single GL mesh, each of them is drawn through a view of the merged mesh
+ *
+ * Views drawn through a \ref UniformBatch are grouped in multi-draw calls. The parts are added with \ref add and the
+ * GL mesh is created by \ref build, the views must not be drawn before that.
+ */
+struct MergedMesh
+{
+  MergedMesh() = default;
+  MergedMesh(const MergedMesh &) = delete;
+  MergedMesh & operator=(const MergedMesh &) = delete;
+
+  /** Add \p mesh to the merged mesh
+   *
+   * \returns The view of \p mesh in the merged mesh, nullptr if it cannot be merged (not made of triangles or missing
+   * positions/normals)
+   */
+  GL::MeshView * add(const Trade::MeshData & mesh);
+
+  /** Create the GL mesh from the meshes added so far, the CPU copies are released */
+  void build();
+
+  /** Number of meshes merged */
+  inline size_t size() const noexcept { return views_.size(); }
+
+  /** Size of the vertex and index data of the GL mesh (bytes) */
+  inline size_t bytes() const noexcept { return bytes_; }
+
+private:
+  GL::Mesh mesh_{NoCreate};
+  std::vector<Trade::MeshData> parts_;
+  /** Views are referenced by the drawables so their storage must be stable */
+  std::deque<GL::MeshView> views_;
+  UnsignedInt indexCount_ = 0;
+  size_t bytes_ = 0;
+};
+
+} // namespace mc_rtc::magnum
@@ -1,4 +1,6 @@
 #include "Mesh.h"
+#include "InstancedMesh.h"
+#include "RenderQueue.h"
 
 #include <Corrade/Containers/Pair.h>
 
@@ -10,70 +12,172 @@ Mesh::Mesh(Object3D * parent,
            ImportedMesh & data,
            Shaders::PhongGL & colorShader,
            Shaders::PhongGL & textureShader,
-           Color4 color)
-: CommonDrawable(parent, group)
+           Color4 color,
+           UniformBatch * batch,
+           InstancedMesh * placeholder)
+: CommonDrawable(parent, group), data_(data), group_(group), colorShader_(colorShader), textureShader_(textureShader),
+  color_(color), batch_(batch), placeholder_(placeholder)
 {
-  if(data.scene_)
+  data_.users_++;
+  build();
+}
+
+Mesh::~Mesh()
+{
+  if(--data_.users_ == 0) { data_.released_ = std::chrono::steady_clock::now(); }
+}
+
+bool Mesh::build()
+{
+  if(built_) { return true; }
+  if(!data_.ready_) { return false; }
+  built_ = true;
+  if(data_.scene_)
   {
-    Containers::Array<Object3D *> objects{std::size_t(data.scene_->mappingBound())};
-    Containers::Array<Containers::Pair<UnsignedInt, Int>> parents = data.scene_->parentsAsArray();
+    Containers::Array<Object3D *> objects{std::size_t(data_.scene_->mappingBound())};
+    Containers::Array<Containers::Pair<UnsignedInt, Int>> parents = data_.scene_->parentsAsArray();
     for(const Containers::Pair<UnsignedInt, Int> & parent : parents) { objects[parent.first()] = new Object3D{}; }
     for(const Containers::Pair<UnsignedInt, Int> & parent : parents)
     {
       objects[parent.first()]->setParent(parent.second() == -1 ? this : objects[parent.second()]);
     }
-    for(const Containers::Pair<UnsignedInt, Matrix4> & transformation : data.scene_->transformations3DAsArray())
+    for(const Containers::Pair<UnsignedInt, Matrix4> & transformation : data_.scene_->transformations3DAsArray())
     {
       if(Object3D * object = objects[transformation.first()]) { object->setTransformation(transformation.second()); }
     }
     for(const Containers::Pair<UnsignedInt, Containers::Pair<UnsignedInt, Int>> & meshMaterial :
-        data.scene_->meshesMaterialsAsArray())
+        data_.scene_->meshesMaterialsAsArray())
     {
       Object3D * object = objects[meshMaterial.first()];
-      Containers::Optional<GL::Mesh> & mesh = data.meshes_[meshMaterial.second().first()];
+      UnsignedInt meshId = meshMaterial.second().first();
+      Containers::Optional<GL::Mesh> & mesh = data_.meshes_[meshId];
       if(!object || !mesh) continue;
 
       Int materialId = meshMaterial.second().second();
 
       /* Material not available / not loaded, use a default material */
-      if(materialId == -1 || !data.materials_[materialId])
+      if(materialId == -1 || !data_.materials_[materialId])
       {
-        drawables_.push_back(new ColoredDrawable{object, group, colorShader, *mesh, color});
+        auto * drawable = new ColoredDrawable{object, group_, colorShader_, *mesh, color_};
+        drawable->batched(batch_);
+        drawables_.push_back(drawable);
+        addLods(drawable, meshId);
       }
       /* Textured material, if the texture loaded correctly */
-      else if(data.materials_[materialId]->hasAttribute(Trade::MaterialAttribute::DiffuseTexture)
-              && data.textures_[data.materials_[materialId]->diffuseTexture()])
+      else if(data_.materials_[materialId]->hasAttribute(Trade::MaterialAttribute::DiffuseTexture)
+              && data_.textures_[data_.materials_[materialId]->diffuseTexture()])
       {
-        drawables_.push_back(new TexturedDrawable{object, group, textureShader, *mesh,
-                                                  *data.textures_[data.materials_[materialId]->diffuseTexture()]});
+        drawables_.push_back(new TexturedDrawable{object, group_, textureShader_, *mesh,
+                                                  *data_.textures_[data_.materials_[materialId]->diffuseTexture()]});
       }
       /* Color-only material */
       else
       {
         Containers::Optional<Color4> ambient = Containers::NullOpt;
-        auto diffuse = color;
-        if(data.materials_[materialId]->hasAttribute(Trade::MaterialAttribute::DiffuseColor))
+        auto diffuse = color_;
+        if(data_.materials_[materialId]->hasAttribute(Trade::MaterialAttribute::DiffuseColor))
         {
-          diffuse = data.materials_[materialId]->diffuseColor();
-          if(diffuse == 0xffffffff_rgbaf) { diffuse = color; }
+          diffuse = data_.materials_[materialId]->diffuseColor();
+          if(diffuse == 0xffffffff_rgbaf) { diffuse = color_; }
         }
-        if(data.materials_[materialId]->hasAttribute(Trade::MaterialAttribute::AmbientColor))
+        if(data_.materials_[materialId]->hasAttribute(Trade::MaterialAttribute::AmbientColor))
         {
-          ambient = data.materials_[materialId]->ambientColor();
+          ambient = data_.materials_[materialId]->ambientColor();
         }
-        drawables_.push_back(new ColoredDrawable{object, group, colorShader, *mesh, diffuse, ambient});
+        auto * drawable = new ColoredDrawable{object, group_, colorShader_, *mesh, diffuse, ambient};
+        drawable->batched(batch_);
+        drawables_.push_back(drawable);
+        addLods(drawable, meshId);
       }
+      drawables_.back()->bounds(data_.bounds_[meshId]);
+      if(!data_.decode_.isEmpty()) { drawables_.back()->setTransformation(data_.decode_[meshId]); }
+    }
+  }
+  else if(!data_.meshes_.isEmpty() && data_.meshes_[0])
+  {
+    auto * drawable = new ColoredDrawable(this, group_, colorShader_, *data_.meshes_[0], color_);
+    drawable->batched(batch_);
+    drawables_.push_back(drawable);
+    drawables_.back()->bounds(data_.bounds_[0]);
+    if(!data_.decode_.isEmpty()) { drawables_.back()->setTransformation(data_.decode_[0]); }
+    addLods(drawable, 0);
+  }
+  /* The parts are drawn with the mesh transformation and their own, which dequantizes optimized meshes */
+  if(!drawables_.empty())
+  {
+    Range3D range = transformBounds(drawables_[0]->transformationMatrix(), *drawables_[0]->bounds());
+    for(const auto & d : drawables_)
+    {
+      range = Math::join(range, transformBounds(d->transformationMatrix(), *d->bounds()));
     }
+    bounds(range);
   }
-  else if(!data.meshes_.isEmpty() && data.meshes_[0])
+  if(alpha_) { alpha(*alpha_); }
+  if(hidden())
   {
-    drawables_.push_back(new ColoredDrawable(this, group, colorShader, *data.meshes_[0], color));
+    for(auto & d : drawables_) { d->hidden(true); }
+  }
+  return true;
+}
+
+void Mesh::addLods(ColoredDrawable * drawable, UnsignedInt meshId)
+{
+  auto decode = [this](UnsignedInt id) { return data_.decode_.isEmpty() ? Matrix4{} : data_.decode_[id]; };
+  /* Batched parts are drawn through their view of the import's merged mesh */
+  auto view = [this](UnsignedInt id) { return batch_ && !data_.views_.isEmpty() ? data_.views_[id] : nullptr; };
+  drawable->view(view(meshId));
+  LodPart part{drawable, {{&*data_.meshes_[meshId], 0.0f, decode(meshId), data_.bounds_[meshId], view(meshId)}}};
+  for(const auto & l : data_.lods_)
+  {
+    if(l.mesh != meshId || !data_.meshes_[l.lod]) { continue; }
+    part.levels.push_back({&*data_.meshes_[l.lod], l.error, decode(l.lod), data_.bounds_[l.lod], view(l.lod)});
+  }
+  if(part.levels.size() > 1) { lodParts_.push_back(std::move(part)); }
+}
+
+void Mesh::selectLods(const RenderQueue & queue, const Matrix4 & transformationMatrix)
+{
+  float scale = Math::sqrt(transformationMatrix.scalingSquared().max());
+  for(auto & part : lodParts_)
+  {
+    auto * d = part.drawable;
+    Vector3 center = (transformationMatrix * d->transformationMatrix()).transformPoint(d->bounds()->center());
+    float pixel = queue.pixelSize(center);
+    size_t level = part.level;
+    while(level + 1 < part.levels.size()
+          && part.levels[level + 1].error * scale < LodHysteresis * LodPixels * pixel)
+    {
+      ++level;
+    }
+    while(level > 0 && part.levels[level].error * scale > LodPixels * pixel) { --level; }
+    if(level == part.level) { continue; }
+    part.level = level;
+    const auto & l = part.levels[level];
+    d->mesh(*l.mesh);
+    d->view(l.view);
+    d->setTransformation(l.decode);
+    d->bounds(l.bounds);
+  }
+}
+
+void Mesh::submit(RenderQueue & queue, const Matrix4 & transformationMatrix)
+{
+  if(!build())
+  {
+    if(placeholder_ && !hidden())
+    {
+      placeholder_->add(transformationMatrix * Matrix4::scaling(Vector3{0.025f}), 0x888888ff_rgbaf);
+    }
+    return;
   }
+  selectLods(queue, transformationMatrix);
+  for(auto & d : drawables_) { d->submit(queue, transformationMatrix * d->transformationMatrix()); }
 }
 
 void Mesh::draw_(const Matrix4 & transformationMatrix, SceneGraph::Camera3D & camera)
 {
-  for(auto & d : drawables_) { d->draw_(transformationMatrix, camera); }
+  if(!build()) { return; }
+  for(auto & d : drawables_) { d->draw_(transformationMatrix * d->transformationMatrix(), camera); }
 }
 
 } // namespace mc_rtc::magnum
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "Importer.h"
+#include "MergedMesh.h"
 #include "Primitives.h"
 
+#include <chrono>
 #include <memory>
 
 namespace mc_rtc::magnum
@@ -10,28 +13,100 @@ namespace mc_rtc::magnum
 struct ImportedMesh
 {
   Containers::Array<Containers::Optional<GL::Mesh>> meshes_;
+  /** Bounds of each mesh */
+  Containers::Array<Range3D> bounds_;
+  /** Transformation applied to quantized meshes, empty if no mesh is quantized */
+  Containers::Array<Matrix4> decode_;
+  /** Levels of detail of the meshes */
+  Containers::Array<ImportedData::Lod> lods_;
   Containers::Array<Containers::Optional<Trade::PhongMaterialData>> materials_;
   Containers::Array<Containers::Optional<GL::Texture2D>> textures_;
   Containers::Optional<Trade::SceneData> scene_;
+  /** Import running in the background, reset once its result has been uploaded */
+  ImportJobPtr job_;
+  /** GL objects that are still waiting in the upload queue */
+  size_t uploads_ = 0;
+  /** True once the data above is available */
+  bool ready_ = false;
+  /** Number of \ref Mesh using this data, unused data can be evicted */
+  size_t users_ = 0;
+  /** Last time \ref users_ dropped to zero */
+  std::chrono::steady_clock::time_point released_;
+  /** Estimated GPU memory used by the meshes and textures (bytes) */
+  size_t gpuBytes_ = 0;
+  /** Meshes that can be batched merged in a single GL mesh, only created when a \ref UniformBatch is used */
+  Containers::Optional<MergedMesh> merged_;
+  /** View of each mesh in \ref merged_, nullptr for the meshes that could not be merged */
+  Containers::Array<GL::MeshView *> views_;
 };
 
 struct Mesh : public CommonDrawable
 {
+  /** Geometric error (in pixels) under which a level of detail is used */
+  static constexpr float LodPixels = 1.0f;
+
+  /** A coarser level is only picked once its error is under this fraction of \ref LodPixels to avoid popping */
+  static constexpr float LodHysteresis = 0.7f;
+
   Mesh(Object3D * parent,
        SceneGraph::DrawableGroup3D * group,
        ImportedMesh & data,
        Shaders::PhongGL & colorShader,
        Shaders::PhongGL & textureShader,
-       Color4 color);
+       Color4 color,
+       UniformBatch * batch = nullptr,
+       InstancedMesh * placeholder = nullptr);
+
+  ~Mesh() override;
 
   inline void alpha(float alpha) noexcept override
   {
+    alpha_ = alpha;
     for(auto & d : drawables_) { d->alpha(alpha); }
   }
 
+  /** Submit the parts of the mesh, or a placeholder if the mesh is still loading */
+  void submit(RenderQueue & queue, const Matrix4 & transformationMatrix) override;
+
 private:
+  ImportedMesh & data_;
+  SceneGraph::DrawableGroup3D * group_;
+  Shaders::PhongGL & colorShader_;
+  Shaders::PhongGL & textureShader_;
+  Color4 color_;
+  UniformBatch * batch_;
+  InstancedMesh * placeholder_;
+  Containers::Optional<float> alpha_;
+  bool built_ = false;
   std::vector<CommonDrawable *> drawables_;
 
+  struct LodLevel
+  {
+    GL::Mesh * mesh;
+    float error;
+    Matrix4 decode;
+    Range3D bounds;
+    /** View of the level in the merged mesh, used when batched */
+    GL::MeshView * view;
+  };
+  /** Levels of detail of a part, level 0 is the full resolution mesh */
+  struct LodPart
+  {
+    ColoredDrawable * drawable;
+    std::vector<LodLevel> levels;
+    size_t level = 0;
+  };
+  std::vector<LodPart> lodParts_;
+
+  /** Register the levels of detail of \p meshId drawn by \p drawable */
+  void addLods(ColoredDrawable * drawable, UnsignedInt meshId);
+
+  /** Pick the level of detail of each part for the mesh drawn with \p transformationMatrix */
+  void selectLods(const RenderQueue & queue, const Matrix4 & transformationMatrix);
+
+  /** Create the parts of the mesh once the data is ready, returns false while it is loading */
+  bool build();
+
   void draw_(const Matrix4 & transformationMatrix, SceneGraph::Camera3D & camera) override;
 };
 
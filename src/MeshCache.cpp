@@ -0,0 +1,656 @@
+#include "MeshCache.h"
+#include "Importer.h"
+
+#include <Corrade/Containers/ArrayTuple.h>
+#include <Corrade/Containers/Pair.h>
+#include <Corrade/Containers/StridedArrayView.h>
+#include <Corrade/Utility/Algorithms.h>
+#include <Corrade/Utility/Path.h>
+#include <Magnum/Mesh.h>
+
+#include <mc_rtc/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace mc_rtc::magnum
+{
+
+namespace
+{
+
+/** Bumped whenever the layout of an entry or the import settings change */
+constexpr UnsignedInt Version = 5;
+
+/** Every blob is aligned on this boundary in an entry, this covers all the vertex formats we can get */
+constexpr size_t Alignment = 16;
+
+struct Header
+{
+  char magic[4] = {'M', 'C', 'M', 'C'};
+  UnsignedInt version = Version;
+  UnsignedLong mtime = 0;
+  UnsignedLong size = 0;
+  UnsignedLong hash = 0;
+};
+
+/** FNV-1a over the content of a file */
+UnsignedLong hash(Containers::ArrayView<const char> data)
+{
+  UnsignedLong h = 14695981039346656037ull;
+  for(char c : data) { h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull; }
+  return h;
+}
+
+UnsignedLong hash(const std::string & data)
+{
+  return hash(Containers::ArrayView<const char>{data.data(), data.size()});
+}
+
+/** Content hash of \p path, 0 if it could not be read */
+UnsignedLong fileHash(const std::string & path)
+{
+  auto data = Utility::Path::mapRead(path);
+  if(!data) { return 0; }
+  return hash(*data);
+}
+
+struct Writer
+{
+  std::string data;
+
+  template<typename T>
+  void write(const T & value)
+  {
+    data.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void blob(Containers::ArrayView<const char> bytes)
+  {
+    write<UnsignedLong>(bytes.size());
+    align();
+    data.append(bytes.data(), bytes.size());
+  }
+
+  void align() { data.resize((data.size() + Alignment - 1) / Alignment * Alignment, '\0'); }
+};
+
+/** Reads an entry, \ref ok is false once the entry has been found to be truncated or invalid */
+struct Reader
+{
+  Containers::ArrayView<const char> data;
+  size_t offset = 0;
+  bool ok = true;
+
+  template<typename T>
+  T read()
+  {
+    T out{};
+    if(!ok || offset + sizeof(T) > data.size())
+    {
+      ok = false;
+      return out;
+    }
+    std::memcpy(&out, data.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return out;
+  }
+
+  Containers::ArrayView<const char> blob()
+  {
+    auto size = read<UnsignedLong>();
+    offset = (offset + Alignment - 1) / Alignment * Alignment;
+    if(!ok || offset + size > data.size())
+    {
+      ok = false;
+      return {};
+    }
+    auto out = data.slice(offset, offset + size);
+    offset += size;
+    return out;
+  }
+};
+
+/** Size of an attribute element for the name/format pairs we write, 0 for anything else */
+size_t attributeSize(Trade::MeshAttribute name, VertexFormat format)
+{
+  switch(name)
+  {
+    case Trade::MeshAttribute::Position:
+      if(format == VertexFormat::Vector3) { return 12; }
+      if(format == VertexFormat::Vector3s) { return 6; }
+      return 0;
+    case Trade::MeshAttribute::Normal:
+      if(format == VertexFormat::Vector3) { return 12; }
+      if(format == VertexFormat::Vector3bNormalized) { return 3; }
+      return 0;
+    case Trade::MeshAttribute::Tangent:
+      if(format == VertexFormat::Vector3) { return 12; }
+      if(format == VertexFormat::Vector4) { return 16; }
+      return 0;
+    case Trade::MeshAttribute::Bitangent:
+      return format == VertexFormat::Vector3 ? 12 : 0;
+    case Trade::MeshAttribute::TextureCoordinates:
+      return format == VertexFormat::Vector2 ? 8 : 0;
+    case Trade::MeshAttribute::Color:
+      if(format == VertexFormat::Vector3) { return 12; }
+      if(format == VertexFormat::Vector4) { return 16; }
+      return 0;
+    default:
+      return 0;
+  }
+}
+
+bool validPrimitive(MeshPrimitive primitive)
+{
+  switch(primitive)
+  {
+    case MeshPrimitive::Points:
+    case MeshPrimitive::Lines:
+    case MeshPrimitive::LineLoop:
+    case MeshPrimitive::LineStrip:
+    case MeshPrimitive::Triangles:
+    case MeshPrimitive::TriangleStrip:
+    case MeshPrimitive::TriangleFan:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/** Largest index in \p data, the caller checked that \p type is valid */
+UnsignedInt maxIndex(MeshIndexType type, Containers::ArrayView<const char> data)
+{
+  auto max = [](auto indices)
+  {
+    UnsignedInt out = 0;
+    for(auto i : indices) { out = std::max(out, UnsignedInt(i)); }
+    return out;
+  };
+  if(type == MeshIndexType::UnsignedByte) { return max(Containers::arrayCast<const UnsignedByte>(data)); }
+  if(type == MeshIndexType::UnsignedShort) { return max(Containers::arrayCast<const UnsignedShort>(data)); }
+  return max(Containers::arrayCast<const UnsignedInt>(data));
+}
+
+void writeMesh(Writer & w, const Trade::MeshData & mesh, const Range3D & bounds)
+{
+  w.write(UnsignedInt(mesh.primitive()));
+  w.write(mesh.vertexCount());
+  w.write(bounds);
+  w.write(mesh.attributeCount());
+  for(UnsignedInt i = 0; i < mesh.attributeCount(); ++i)
+  {
+    w.write(UnsignedShort(mesh.attributeName(i)));
+    w.write(UnsignedInt(mesh.attributeFormat(i)));
+    w.write(UnsignedLong(mesh.attributeOffset(i)));
+    w.write(Long(mesh.attributeStride(i)));
+    w.write(mesh.attributeArraySize(i));
+  }
+  w.blob(mesh.vertexData());
+  w.write(mesh.isIndexed());
+  if(mesh.isIndexed())
+  {
+    w.write(UnsignedInt(mesh.indexType()));
+    w.write(mesh.indexCount());
+    w.blob(mesh.indexData().slice(mesh.indexOffset(),
+                                  mesh.indexOffset() + mesh.indexCount() * meshIndexTypeSize(mesh.indexType())));
+  }
+}
+
+Containers::Optional<Trade::MeshData> readMesh(Reader & r, Range3D & bounds)
+{
+  auto primitive = MeshPrimitive(r.read<UnsignedInt>());
+  auto vertexCount = r.read<UnsignedInt>();
+  bounds = r.read<Range3D>();
+  auto attributeCount = r.read<UnsignedInt>();
+  /* We never write more than a handful of attributes per mesh */
+  if(!r.ok || !validPrimitive(primitive) || attributeCount > 16)
+  {
+    r.ok = false;
+    return {};
+  }
+  /* Attributes are only created once the vertex data is known to hold them all, MeshData asserts otherwise */
+  struct Attribute
+  {
+    Trade::MeshAttribute name;
+    VertexFormat format;
+    UnsignedLong offset;
+    Long stride;
+    UnsignedShort arraySize;
+  };
+  Containers::Array<Attribute> layout{attributeCount};
+  for(auto & a : layout)
+  {
+    a.name = Trade::MeshAttribute(r.read<UnsignedShort>());
+    a.format = VertexFormat(r.read<UnsignedInt>());
+    a.offset = r.read<UnsignedLong>();
+    a.stride = r.read<Long>();
+    a.arraySize = r.read<UnsignedShort>();
+  }
+  auto vertexData = r.blob();
+  bool indexed = r.read<bool>();
+  if(!r.ok) { return {}; }
+  Containers::Array<Trade::MeshAttributeData> attributes{attributeCount};
+  for(UnsignedInt i = 0; i < attributeCount; ++i)
+  {
+    const auto & a = layout[i];
+    size_t size = attributeSize(a.name, a.format);
+    if(size == 0 || a.arraySize != 0 || a.stride <= 0 || a.stride > 32767
+       || (vertexCount
+           && (a.offset > vertexData.size()
+               || (vertexCount - 1) * UnsignedLong(a.stride) + size > vertexData.size() - a.offset)))
+    {
+      r.ok = false;
+      return {};
+    }
+    attributes[i] = Trade::MeshAttributeData{a.name, a.format, std::size_t(a.offset), vertexCount,
+                                             std::ptrdiff_t(a.stride)};
+  }
+  if(!indexed)
+  {
+    return Trade::MeshData{primitive, Trade::DataFlags{}, vertexData, std::move(attributes), vertexCount};
+  }
+  auto indexType = MeshIndexType(r.read<UnsignedInt>());
+  auto indexCount = r.read<UnsignedInt>();
+  auto indexData = r.blob();
+  if(!r.ok) { return {}; }
+  if((indexType != MeshIndexType::UnsignedByte && indexType != MeshIndexType::UnsignedShort
+      && indexType != MeshIndexType::UnsignedInt)
+     || indexData.size() != UnsignedLong(indexCount) * meshIndexTypeSize(indexType)
+     || (indexCount && maxIndex(indexType, indexData) >= vertexCount))
+  {
+    r.ok = false;
+    return {};
+  }
+  return Trade::MeshData{primitive,
+                         Trade::DataFlags{},
+                         indexData,
+                         Trade::MeshIndexData{indexType, indexData},
+                         Trade::DataFlags{},
+                         vertexData,
+                         std::move(attributes),
+                         vertexCount};
+}
+
+void writeTexture(Writer & w, const ImportedData::Texture & texture)
+{
+  w.write(UnsignedInt(texture.magnificationFilter));
+  w.write(UnsignedInt(texture.minificationFilter));
+  w.write(UnsignedInt(texture.mipmapFilter));
+  w.write(UnsignedInt(texture.wrapping.x()));
+  w.write(UnsignedInt(texture.wrapping.y()));
+  w.write(UnsignedInt(texture.image.format()));
+  /* The pixels are written tightly packed so padded or offset images round-trip too */
+  auto pixels = texture.image.pixels();
+  Containers::Array<char> packed{NoInit, pixels.size()[0] * pixels.size()[1] * pixels.size()[2]};
+  Utility::copy(pixels, Containers::StridedArrayView3D<char>{packed, pixels.size()});
+  w.write(Int(1));
+  w.write(texture.image.size());
+  w.blob(packed);
+}
+
+bool validFilter(SamplerFilter filter)
+{
+  return filter == SamplerFilter::Nearest || filter == SamplerFilter::Linear;
+}
+
+bool validMipmap(SamplerMipmap mipmap)
+{
+  return mipmap == SamplerMipmap::Base || mipmap == SamplerMipmap::Nearest || mipmap == SamplerMipmap::Linear;
+}
+
+bool validWrapping(SamplerWrapping wrapping)
+{
+  switch(wrapping)
+  {
+    case SamplerWrapping::Repeat:
+    case SamplerWrapping::MirroredRepeat:
+    case SamplerWrapping::ClampToEdge:
+    case SamplerWrapping::ClampToBorder:
+    case SamplerWrapping::MirrorClampToEdge:
+      return true;
+    default:
+      return false;
+  }
+}
+
+Containers::Optional<ImportedData::Texture> readTexture(Reader & r)
+{
+  auto magnification = SamplerFilter(r.read<UnsignedInt>());
+  auto minification = SamplerFilter(r.read<UnsignedInt>());
+  auto mipmap = SamplerMipmap(r.read<UnsignedInt>());
+  auto wrapX = SamplerWrapping(r.read<UnsignedInt>());
+  auto wrapY = SamplerWrapping(r.read<UnsignedInt>());
+  auto format = PixelFormat(r.read<UnsignedInt>());
+  auto alignment = r.read<Int>();
+  auto size = r.read<Vector2i>();
+  auto data = r.blob();
+  if(!r.ok) { return {}; }
+  /* Only the formats accepted by the importer are written */
+  size_t pixelSize = format == PixelFormat::RGB8Unorm ? 3 : format == PixelFormat::RGBA8Unorm ? 4 : 0;
+  bool alignmentOk = alignment == 1 || alignment == 2 || alignment == 4 || alignment == 8;
+  if(!validFilter(magnification) || !validFilter(minification) || !validMipmap(mipmap) || !validWrapping(wrapX)
+     || !validWrapping(wrapY) || pixelSize == 0 || !alignmentOk || size.x() <= 0 || size.y() <= 0
+     || size.x() > 65536 || size.y() > 65536)
+  {
+    r.ok = false;
+    return {};
+  }
+  size_t row = (size_t(size.x()) * pixelSize + alignment - 1) / size_t(alignment) * size_t(alignment);
+  if(data.size() < row * size_t(size.y()))
+  {
+    r.ok = false;
+    return {};
+  }
+  return ImportedData::Texture{
+      magnification, minification, mipmap, {wrapX, wrapY},
+      Trade::ImageData2D{PixelStorage{}.setAlignment(alignment), format, size, Trade::DataFlags{}, data}};
+}
+
+/** Only the properties used by \ref Mesh are kept */
+void writeMaterial(Writer & w, const Trade::PhongMaterialData & material)
+{
+  bool texture = material.hasAttribute(Trade::MaterialAttribute::DiffuseTexture);
+  bool diffuse = material.hasAttribute(Trade::MaterialAttribute::DiffuseColor);
+  bool ambient = material.hasAttribute(Trade::MaterialAttribute::AmbientColor);
+  w.write(texture);
+  w.write(texture ? material.diffuseTexture() : 0u);
+  w.write(diffuse);
+  w.write(diffuse ? material.diffuseColor() : Color4{});
+  w.write(ambient);
+  w.write(ambient ? material.ambientColor() : Color4{});
+}
+
+Containers::Optional<Trade::PhongMaterialData> readMaterial(Reader & r, size_t textureCount)
+{
+  bool texture = r.read<bool>();
+  auto textureId = r.read<UnsignedInt>();
+  bool diffuse = r.read<bool>();
+  auto diffuseColor = r.read<Color4>();
+  bool ambient = r.read<bool>();
+  auto ambientColor = r.read<Color4>();
+  if(!r.ok) { return {}; }
+  if(texture && textureId >= textureCount)
+  {
+    r.ok = false;
+    return {};
+  }
+  Containers::Array<Trade::MaterialAttributeData> attributes{size_t(texture) + size_t(diffuse) + size_t(ambient)};
+  size_t i = 0;
+  if(texture) { attributes[i++] = {Trade::MaterialAttribute::DiffuseTexture, textureId}; }
+  if(diffuse) { attributes[i++] = {Trade::MaterialAttribute::DiffuseColor, diffuseColor}; }
+  if(ambient) { attributes[i++] = {Trade::MaterialAttribute::AmbientColor, ambientColor}; }
+  Trade::MaterialData material{Trade::MaterialType::Phong, std::move(attributes)};
+  return std::move(static_cast<Trade::PhongMaterialData &>(material));
+}
+
+/** Only the hierarchy, transformations and mesh assignments are kept */
+void writeScene(Writer & w, const Trade::SceneData & scene)
+{
+  auto parents = scene.parentsAsArray();
+  auto transformations = scene.transformations3DAsArray();
+  auto meshesMaterials = scene.meshesMaterialsAsArray();
+  w.write(UnsignedLong(scene.mappingBound()));
+  w.write(UnsignedLong(parents.size()));
+  w.write(UnsignedLong(transformations.size()));
+  w.write(UnsignedLong(meshesMaterials.size()));
+  for(const auto & p : parents)
+  {
+    w.write(p.first());
+    w.write(p.second());
+  }
+  for(const auto & t : transformations)
+  {
+    w.write(t.first());
+    w.write(t.second());
+  }
+  for(const auto & m : meshesMaterials)
+  {
+    w.write(m.first());
+    w.write(m.second().first());
+    w.write(m.second().second());
+  }
+}
+
+/** \p meshCount and \p materialCount bound the references made by the scene */
+Containers::Optional<Trade::SceneData> readScene(Reader & r, size_t meshCount, size_t materialCount)
+{
+  auto bound = r.read<UnsignedLong>();
+  auto parentCount = r.read<UnsignedLong>();
+  auto transformationCount = r.read<UnsignedLong>();
+  auto meshMaterialCount = r.read<UnsignedLong>();
+  size_t remaining = r.data.size() - std::min(r.offset, r.data.size());
+  if(!r.ok || bound > 0xffffffffull || parentCount > remaining || transformationCount > remaining
+     || meshMaterialCount > remaining
+     || parentCount * 8 + transformationCount * (4 + sizeof(Matrix4)) + meshMaterialCount * 12 > remaining)
+  {
+    r.ok = false;
+    return {};
+  }
+  /* The fields are copied in a single allocation owned by the SceneData */
+  Containers::ArrayView<UnsignedInt> parentMapping;
+  Containers::ArrayView<Int> parents;
+  Containers::ArrayView<UnsignedInt> transformationMapping;
+  Containers::ArrayView<Matrix4> transformations;
+  Containers::ArrayView<UnsignedInt> meshMapping;
+  Containers::ArrayView<UnsignedInt> meshes;
+  Containers::ArrayView<Int> materials;
+  Containers::Array<char> data = Containers::ArrayTuple{{NoInit, parentCount, parentMapping},
+                                                        {NoInit, parentCount, parents},
+                                                        {NoInit, transformationCount, transformationMapping},
+                                                        {NoInit, transformationCount, transformations},
+                                                        {NoInit, meshMaterialCount, meshMapping},
+                                                        {NoInit, meshMaterialCount, meshes},
+                                                        {NoInit, meshMaterialCount, materials}};
+  /* Mesh::build() indexes its objects, meshes and materials with these directly */
+  auto object = [bound](Long id) { return id >= 0 && UnsignedLong(id) < bound; };
+  for(size_t i = 0; i < parentCount; ++i)
+  {
+    parentMapping[i] = r.read<UnsignedInt>();
+    parents[i] = r.read<Int>();
+    r.ok = r.ok && object(parentMapping[i]) && (parents[i] == -1 || object(parents[i]));
+  }
+  for(size_t i = 0; i < transformationCount; ++i)
+  {
+    transformationMapping[i] = r.read<UnsignedInt>();
+    transformations[i] = r.read<Matrix4>();
+    r.ok = r.ok && object(transformationMapping[i]);
+  }
+  for(size_t i = 0; i < meshMaterialCount; ++i)
+  {
+    meshMapping[i] = r.read<UnsignedInt>();
+    meshes[i] = r.read<UnsignedInt>();
+    materials[i] = r.read<Int>();
+    r.ok = r.ok && object(meshMapping[i]) && meshes[i] < meshCount
+           && (materials[i] == -1 || (materials[i] >= 0 && size_t(materials[i]) < materialCount));
+  }
+  if(!r.ok) { return {}; }
+  Containers::Array<Trade::SceneFieldData> fields{
+      InPlaceInit,
+      {Trade::SceneFieldData{Trade::SceneField::Parent, parentMapping, parents},
+       Trade::SceneFieldData{Trade::SceneField::Transformation, transformationMapping, transformations},
+       Trade::SceneFieldData{Trade::SceneField::Mesh, meshMapping, meshes},
+       Trade::SceneFieldData{Trade::SceneField::MeshMaterial, meshMapping, materials}}};
+  return Trade::SceneData{Trade::SceneMappingType::UnsignedInt, bound, std::move(data), std::move(fields)};
+}
+
+/** True if \p mesh passes the checks of \ref readMesh, other meshes cannot be cached */
+bool cacheable(const Trade::MeshData & mesh)
+{
+  if(!validPrimitive(mesh.primitive())) { return false; }
+  for(UnsignedInt i = 0; i < mesh.attributeCount(); ++i)
+  {
+    if(attributeSize(mesh.attributeName(i), mesh.attributeFormat(i)) == 0 || mesh.attributeArraySize(i) != 0
+       || mesh.attributeStride(i) <= 0 || mesh.attributeStride(i) > 32767)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** True if \p texture passes the checks of \ref readTexture, other textures cannot be cached */
+bool cacheable(const ImportedData::Texture & texture)
+{
+  auto format = texture.image.format();
+  auto size = texture.image.size();
+  return validFilter(texture.magnificationFilter) && validFilter(texture.minificationFilter)
+         && validMipmap(texture.mipmapFilter) && validWrapping(texture.wrapping.x())
+         && validWrapping(texture.wrapping.y())
+         && (format == PixelFormat::RGB8Unorm || format == PixelFormat::RGBA8Unorm) && size.x() > 0 && size.y() > 0
+         && size.x() <= 65536 && size.y() <= 65536;
+}
+
+} // namespace
+
+MeshCache::MeshCache(bfs::path directory, std::string variant)
+: directory_(std::move(directory)), variant_(std::move(variant))
+{
+  if(directory_.empty()) { return; }
+  boost::system::error_code ec;
+  bfs::create_directories(directory_, ec);
+  if(ec)
+  {
+    mc_rtc::log::warning("Failed to create the mesh cache in {}: {}", directory_.string(), ec.message());
+    directory_.clear();
+  }
+}
+
+bfs::path MeshCache::entry(const std::string & path) const
+{
+  return directory_ / fmt::format("{:016x}.mesh", hash(bfs::absolute(path).string() + variant_));
+}
+
+bool MeshCache::load(const std::string & path, ImportedData & out) const
+{
+  if(!enabled()) { return false; }
+  auto file = entry(path);
+  boost::system::error_code ec;
+  if(!bfs::exists(file, ec)) { return false; }
+  auto mtime = UnsignedLong(bfs::last_write_time(path, ec));
+  if(ec) { return false; }
+  auto size = UnsignedLong(bfs::file_size(path, ec));
+  if(ec) { return false; }
+  auto mapping = Utility::Path::mapRead(file.string());
+  if(!mapping) { return false; }
+  Reader r{*mapping};
+  auto header = r.read<Header>();
+  if(!r.ok || std::memcmp(header.magic, Header{}.magic, 4) != 0 || header.version != Version || header.size != size)
+  {
+    return false;
+  }
+  if(header.mtime != mtime && header.hash != fileHash(path)) { return false; }
+
+  /* Counts are checked against the remaining data before allocating anything from them */
+  auto count = [&r](size_t elementSize)
+  {
+    auto n = r.read<UnsignedInt>();
+    if(r.ok && UnsignedLong(n) * elementSize > r.data.size() - r.offset) { r.ok = false; }
+    return r.ok ? n : 0;
+  };
+  ImportedData data;
+  data.meshes = Containers::Array<Containers::Optional<Trade::MeshData>>{count(sizeof(bool))};
+  data.bounds = Containers::Array<Range3D>{data.meshes.size()};
+  for(size_t i = 0; r.ok && i < data.meshes.size(); ++i)
+  {
+    if(r.read<bool>()) { data.meshes[i] = readMesh(r, data.bounds[i]); }
+  }
+  auto decodeCount = count(sizeof(Matrix4));
+  r.ok = r.ok && (decodeCount == 0 || decodeCount == data.meshes.size());
+  data.decode = Containers::Array<Matrix4>{r.ok ? decodeCount : 0};
+  for(size_t i = 0; r.ok && i < data.decode.size(); ++i) { data.decode[i] = r.read<Matrix4>(); }
+  data.lods = Containers::Array<ImportedData::Lod>{count(sizeof(ImportedData::Lod))};
+  for(size_t i = 0; r.ok && i < data.lods.size(); ++i)
+  {
+    data.lods[i] = r.read<ImportedData::Lod>();
+    r.ok = r.ok && data.lods[i].mesh < data.meshes.size() && data.lods[i].lod < data.meshes.size();
+  }
+  data.textures = Containers::Array<Containers::Optional<ImportedData::Texture>>{count(sizeof(bool))};
+  for(size_t i = 0; r.ok && i < data.textures.size(); ++i)
+  {
+    if(r.read<bool>()) { data.textures[i] = readTexture(r); }
+  }
+  data.materials = Containers::Array<Containers::Optional<Trade::PhongMaterialData>>{count(sizeof(bool))};
+  for(size_t i = 0; r.ok && i < data.materials.size(); ++i)
+  {
+    if(r.read<bool>()) { data.materials[i] = readMaterial(r, data.textures.size()); }
+  }
+  if(r.read<bool>()) { data.scene = readScene(r, data.meshes.size(), data.materials.size()); }
+  if(!r.ok)
+  {
+    mc_rtc::log::warning("Ignoring corrupted mesh cache entry {} for {}", file.string(), path);
+    return false;
+  }
+  /* The meshes and textures point into the mapping */
+  data.mapping = std::move(mapping);
+  out = std::move(data);
+  return true;
+}
+
+void MeshCache::store(const std::string & path, const ImportedData & data) const
+{
+  if(!enabled()) { return; }
+  boost::system::error_code ec;
+  /* Never write an entry that load() would reject, it would be re-imported and rewritten on every launch */
+  auto supported = [](const auto & item) { return !item || cacheable(*item); };
+  bool meshesOk = std::all_of(data.meshes.begin(), data.meshes.end(), supported);
+  bool texturesOk = std::all_of(data.textures.begin(), data.textures.end(), supported);
+  if(!meshesOk || !texturesOk)
+  {
+    mc_rtc::log::info("{} uses data the mesh cache does not support, it will not be cached", path);
+    bfs::remove(entry(path), ec);
+    return;
+  }
+  Header header;
+  header.mtime = UnsignedLong(bfs::last_write_time(path, ec));
+  if(ec) { return; }
+  header.size = UnsignedLong(bfs::file_size(path, ec));
+  if(ec) { return; }
+  header.hash = fileHash(path);
+
+  Writer w;
+  w.write(header);
+  w.write(UnsignedInt(data.meshes.size()));
+  for(size_t i = 0; i < data.meshes.size(); ++i)
+  {
+    w.write(bool(data.meshes[i]));
+    if(data.meshes[i]) { writeMesh(w, *data.meshes[i], data.bounds[i]); }
+  }
+  w.write(UnsignedInt(data.decode.size()));
+  for(const auto & d : data.decode) { w.write(d); }
+  w.write(UnsignedInt(data.lods.size()));
+  for(const auto & l : data.lods) { w.write(l); }
+  w.write(UnsignedInt(data.textures.size()));
+  for(const auto & t : data.textures)
+  {
+    w.write(bool(t));
+    if(t) { writeTexture(w, *t); }
+  }
+  w.write(UnsignedInt(data.materials.size()));
+  for(const auto & m : data.materials)
+  {
+    w.write(bool(m));
+    if(m) { writeMaterial(w, *m); }
+  }
+  w.write(bool(data.scene));
+  if(data.scene) { writeScene(w, *data.scene); }
+
+  /* Write to a temporary file first so a concurrent reader never sees a partial entry */
+  auto file = entry(path);
+  auto tmp = directory_ / bfs::unique_path("%%%%-%%%%-%%%%.tmp");
+  {
+    std::ofstream ofs(tmp.string(), std::ios::binary);
+    ofs.write(w.data.data(), static_cast<std::streamsize>(w.data.size()));
+    if(!ofs)
+    {
+      mc_rtc::log::warning("Failed to write the mesh cache entry for {}", path);
+      bfs::remove(tmp, ec);
+      return;
+    }
+  }
+  bfs::rename(tmp, file, ec);
+  if(ec) { bfs::remove(tmp, ec); }
+}
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "widgets/utils.h"
+
+#include <string>
+
+namespace mc_rtc::magnum
+{
+
+struct ImportedData;
+
+/** On-disk cache of imported meshes
+ *
+ * Each source file is stored in a single file named after the hash of its path. It contains the vertex and index
+ * data of every mesh, ready to be uploaded, as well as the textures, the material properties and the scene
+ * hierarchy we use. Cached files are memory-mapped and the meshes and textures reference the mapping directly.
+ *
+ * An entry is valid if the modification time and size of the source match the ones recorded in the entry. If only
+ * the modification time changed (e.g. the package was reinstalled) the content hash of the source is compared.
+ *
+ * All functions are safe to call from the import threads as long as they work on different paths.
+ */
+struct MeshCache
+{
+  /** Store the cache in \p directory (created if needed), an empty path disables the cache
+   *
+   * Entries of different \p variant (e.g. optimized meshes) are stored separately
+   */
+  explicit MeshCache(bfs::path directory = {}, std::string variant = {});
+
+  inline bool enabled() const noexcept { return !directory_.empty(); }
+
+  /** Load the cached import of \p path in \p out
+   *
+   * \returns False if the cache has no valid entry for \p path
+   */
+  bool load(const std::string & path, ImportedData & out) const;
+
+  /** Store \p data as the import of \p path */
+  void store(const std::string & path, const ImportedData & data) const;
+
+private:
+  bfs::path directory_;
+  std::string variant_;
+
+  /** Cache entry for \p path */
+  bfs::path entry(const std::string & path) const;
+};
+
+} // namespace mc_rtc::magnum
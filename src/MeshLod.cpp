@@ -0,0 +1,99 @@
+#include "MeshLod.h"
+
+#include <Magnum/Math/Functions.h>
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+namespace
+{
+
+struct Vertex
+{
+  Vector3 position;
+  Vector3 normal;
+};
+
+struct Cluster
+{
+  Vector3 position;
+  Vector3 normal;
+  UnsignedInt count = 0;
+};
+
+} // namespace
+
+Containers::Optional<Trade::MeshData> simplifyMesh(const Trade::MeshData & mesh, float cellSize)
+{
+  if(mesh.primitive() != MeshPrimitive::Triangles || !mesh.hasAttribute(Trade::MeshAttribute::Position)
+     || !mesh.hasAttribute(Trade::MeshAttribute::Normal) || mesh.hasAttribute(Trade::MeshAttribute::TextureCoordinates)
+     || mesh.vertexCount() == 0 || cellSize <= 0.0f)
+  {
+    return {};
+  }
+  auto positions = mesh.positions3DAsArray();
+  auto normals = mesh.normalsAsArray();
+  Containers::Array<UnsignedInt> indices;
+  if(mesh.isIndexed()) { indices = mesh.indicesAsArray(); }
+  else
+  {
+    indices = Containers::Array<UnsignedInt>{NoInit, mesh.vertexCount()};
+    for(UnsignedInt i = 0; i < indices.size(); ++i) { indices[i] = i; }
+  }
+
+  /* Assign every vertex to its grid cell, cells coordinates are packed in 21 bits each */
+  Vector3 min{Constants::inf()};
+  for(const auto & p : positions) { min = Math::min(min, p); }
+  std::unordered_map<UnsignedLong, UnsignedInt> cells;
+  cells.reserve(positions.size() / 4);
+  std::vector<Cluster> clusters;
+  Containers::Array<UnsignedInt> cluster{NoInit, positions.size()};
+  for(size_t i = 0; i < positions.size(); ++i)
+  {
+    Vector3ui cell{Math::min(Math::floor((positions[i] - min) / cellSize), Vector3{float((1 << 21) - 1)})};
+    UnsignedLong key = (UnsignedLong(cell.x()) << 42) | (UnsignedLong(cell.y()) << 21) | UnsignedLong(cell.z());
+    auto it = cells.emplace(key, static_cast<UnsignedInt>(clusters.size())).first;
+    if(it->second == clusters.size()) { clusters.emplace_back(); }
+    auto & c = clusters[it->second];
+    c.position += positions[i];
+    c.normal += normals[i];
+    c.count++;
+    cluster[i] = it->second;
+  }
+
+  /* Keep the triangles whose corners are in different clusters */
+  std::vector<UnsignedInt> lodIndices;
+  lodIndices.reserve(indices.size() / 2);
+  for(size_t i = 0; i + 2 < indices.size(); i += 3)
+  {
+    UnsignedInt a = cluster[indices[i]];
+    UnsignedInt b = cluster[indices[i + 1]];
+    UnsignedInt c = cluster[indices[i + 2]];
+    if(a == b || b == c || a == c) { continue; }
+    lodIndices.insert(lodIndices.end(), {a, b, c});
+  }
+
+  Containers::Array<char> vertexData{NoInit, clusters.size() * sizeof(Vertex)};
+  auto vertices = Containers::arrayCast<Vertex>(vertexData);
+  for(size_t i = 0; i < clusters.size(); ++i)
+  {
+    const auto & c = clusters[i];
+    float length = c.normal.length();
+    vertices[i] = {c.position / float(c.count), length > 0.0f ? c.normal / length : Vector3::zAxis()};
+  }
+  Containers::Array<char> indexData{NoInit, lodIndices.size() * sizeof(UnsignedInt)};
+  if(!lodIndices.empty()) { std::memcpy(indexData.data(), lodIndices.data(), indexData.size()); }
+  Trade::MeshIndexData indexView{Containers::arrayCast<UnsignedInt>(indexData)};
+  auto view = Containers::stridedArrayView(vertices);
+  Trade::MeshAttributeData positionsView{Trade::MeshAttribute::Position, view.slice(&Vertex::position)};
+  Trade::MeshAttributeData normalsView{Trade::MeshAttribute::Normal, view.slice(&Vertex::normal)};
+  return Trade::MeshData{MeshPrimitive::Triangles, std::move(indexData), indexView, std::move(vertexData),
+                         Containers::Array<Trade::MeshAttributeData>{InPlaceInit, {positionsView, normalsView}},
+                         static_cast<UnsignedInt>(clusters.size())};
+}
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Camera.h"
+
+namespace mc_rtc::magnum
+{
+
+/** Simplify a triangle mesh by vertex clustering
+ *
+ * Vertices are merged on a regular grid of \p cellSize, each cluster is replaced by the average of its vertices and
+ * triangles that collapse are removed. The vertices of the simplified mesh are at most \p cellSize away from the
+ * original surface which is what we use as the error of the level of detail.
+ *
+ * \returns NullOpt if the mesh cannot be simplified (not made of triangles, missing positions/normals or textured)
+ */
+Containers::Optional<Trade::MeshData> simplifyMesh(const Trade::MeshData & mesh, float cellSize);
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,141 @@
+#include "MeshOptimizer.h"
+
+#include <Magnum/Math/Functions.h>
+#include <Magnum/MeshTools/RemoveDuplicates.h>
+#include <Magnum/MeshTools/Tipsify.h>
+
+#include <cstring>
+
+namespace mc_rtc::magnum
+{
+
+namespace
+{
+
+/** Vertex used while welding, compared bitwise */
+struct Vertex
+{
+  Vector3 position;
+  Vector3 normal;
+  Vector2 textureCoordinates;
+};
+
+/** Size of the post-transform vertex cache assumed by the triangle ordering */
+constexpr std::size_t VertexCacheSize = 24;
+
+/** Layout of the optimized vertices, texture coordinates are only present if the source mesh had them */
+constexpr std::size_t PositionOffset = 0;
+constexpr std::size_t NormalOffset = 8;
+constexpr std::size_t TextureCoordinatesOffset = 12;
+
+} // namespace
+
+Containers::Optional<Trade::MeshData> optimizeMesh(const Trade::MeshData & mesh, Matrix4 & decode)
+{
+  if(mesh.primitive() != MeshPrimitive::Triangles || !mesh.hasAttribute(Trade::MeshAttribute::Position)
+     || !mesh.hasAttribute(Trade::MeshAttribute::Normal) || mesh.vertexCount() == 0)
+  {
+    return {};
+  }
+  bool textured = mesh.hasAttribute(Trade::MeshAttribute::TextureCoordinates);
+
+  /* Gather the vertices in a flat layout and merge the duplicates */
+  Containers::Array<Vertex> vertices{NoInit, mesh.vertexCount()};
+  {
+    auto view = Containers::stridedArrayView(vertices);
+    mesh.positions3DInto(view.slice(&Vertex::position));
+    mesh.normalsInto(view.slice(&Vertex::normal));
+    if(textured) { mesh.textureCoordinates2DInto(view.slice(&Vertex::textureCoordinates)); }
+    else
+    {
+      for(auto & v : vertices) { v.textureCoordinates = {}; }
+    }
+  }
+  Containers::Array<UnsignedInt> indices;
+  if(mesh.isIndexed()) { indices = mesh.indicesAsArray(); }
+  else
+  {
+    indices = Containers::Array<UnsignedInt>{NoInit, mesh.vertexCount()};
+    for(UnsignedInt i = 0; i < indices.size(); ++i) { indices[i] = i; }
+  }
+  if(indices.size() < 3) { return {}; }
+  auto welded =
+      MeshTools::removeDuplicatesInPlace(Containers::arrayCast<2, char>(Containers::stridedArrayView(vertices)));
+  for(auto & i : indices) { i = welded.first()[i]; }
+  auto vertexCount = static_cast<UnsignedInt>(welded.second());
+
+  /* Triangle order for the vertex cache and overdraw, then vertices in the order they are fetched */
+  MeshTools::tipsifyInPlace(Containers::stridedArrayView(indices), vertexCount, VertexCacheSize);
+  constexpr UnsignedInt Unused = ~UnsignedInt{0};
+  Containers::Array<UnsignedInt> remap{DirectInit, vertexCount, Unused};
+  Containers::Array<Vertex> ordered{NoInit, vertexCount};
+  UnsignedInt next = 0;
+  for(auto & i : indices)
+  {
+    if(remap[i] == Unused)
+    {
+      remap[i] = next;
+      ordered[next++] = vertices[i];
+    }
+    i = remap[i];
+  }
+  vertexCount = next;
+
+  /* Quantize the positions in the mesh bounds */
+  Vector3 min{Constants::inf()};
+  Vector3 max{-Constants::inf()};
+  for(UnsignedInt i = 0; i < vertexCount; ++i)
+  {
+    min = Math::min(min, ordered[i].position);
+    max = Math::max(max, ordered[i].position);
+  }
+  Vector3 center = (min + max) / 2.0f;
+  Vector3 scale = (max - min) / 2.0f / 32767.0f;
+  for(size_t i = 0; i < 3; ++i)
+  {
+    if(scale[i] <= 0.0f) { scale[i] = 1.0f; }
+  }
+  decode = Matrix4::translation(center) * Matrix4::scaling(scale);
+
+  std::size_t stride = textured ? TextureCoordinatesOffset + sizeof(Vector2) : TextureCoordinatesOffset;
+  Containers::Array<char> vertexData{ValueInit, vertexCount * stride};
+  Containers::StridedArrayView1D<Vector3s> positions{vertexData, reinterpret_cast<Vector3s *>(vertexData.data()),
+                                                     vertexCount, std::ptrdiff_t(stride)};
+  Containers::StridedArrayView1D<Vector3b> normals{
+      vertexData, reinterpret_cast<Vector3b *>(vertexData.data() + NormalOffset), vertexCount, std::ptrdiff_t(stride)};
+  for(UnsignedInt i = 0; i < vertexCount; ++i)
+  {
+    positions[i] = Vector3s{Math::round((ordered[i].position - center) / scale)};
+    /* The normal matrix of the decode transformation divides by the scale, pre-multiply so it cancels out */
+    normals[i] = Math::pack<Vector3b>((scale * ordered[i].normal).normalized());
+  }
+  Containers::Array<Trade::MeshAttributeData> attributes{textured ? 3u : 2u};
+  attributes[0] = Trade::MeshAttributeData{Trade::MeshAttribute::Position, VertexFormat::Vector3s, positions};
+  attributes[1] = Trade::MeshAttributeData{Trade::MeshAttribute::Normal, VertexFormat::Vector3bNormalized, normals};
+  if(textured)
+  {
+    Containers::StridedArrayView1D<Vector2> textureCoordinates{
+        vertexData, reinterpret_cast<Vector2 *>(vertexData.data() + TextureCoordinatesOffset), vertexCount,
+        std::ptrdiff_t(stride)};
+    for(UnsignedInt i = 0; i < vertexCount; ++i) { textureCoordinates[i] = ordered[i].textureCoordinates; }
+    attributes[2] = Trade::MeshAttributeData{Trade::MeshAttribute::TextureCoordinates, textureCoordinates};
+  }
+
+  /* 16-bit indices when they are enough */
+  if(vertexCount <= 65536)
+  {
+    Containers::Array<char> indexData{NoInit, indices.size() * sizeof(UnsignedShort)};
+    auto shortIndices = Containers::arrayCast<UnsignedShort>(indexData);
+    for(size_t i = 0; i < indices.size(); ++i) { shortIndices[i] = static_cast<UnsignedShort>(indices[i]); }
+    Trade::MeshIndexData indexView{shortIndices};
+    return Trade::MeshData{MeshPrimitive::Triangles, std::move(indexData), indexView, std::move(vertexData),
+                           std::move(attributes), vertexCount};
+  }
+  Containers::Array<char> indexData{NoInit, indices.size() * sizeof(UnsignedInt)};
+  std::memcpy(indexData.data(), indices.data(), indexData.size());
+  Trade::MeshIndexData indexView{Containers::arrayCast<UnsignedInt>(indexData)};
+  return Trade::MeshData{MeshPrimitive::Triangles, std::move(indexData), indexView, std::move(vertexData),
+                         std::move(attributes), vertexCount};
+}
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Camera.h"
+
+namespace mc_rtc::magnum
+{
+
+/** Optimize a triangle mesh for rendering
+ *
+ * - identical vertices are merged;
+ * - triangles are reordered for the post-transform vertex cache and overdraw, vertices are then reordered in the
+ *   order they are used;
+ * - positions are quantized to 16-bit integers, normals to normalized 8-bit integers;
+ * - indices use 16-bit integers when possible.
+ *
+ * Only the position, normal and 2D texture coordinates attributes are kept.
+ *
+ * \param decode Receives the transformation from the quantized positions to the original ones, it must be applied
+ * before the mesh transformation when drawing
+ *
+ * \returns NullOpt if the mesh cannot be optimized (not made of triangles or missing positions/normals)
+ */
+Containers::Optional<Trade::MeshData> optimizeMesh(const Trade::MeshData & mesh, Matrix4 & decode);
+
+} // namespace mc_rtc::magnum
@@ -1,9 +1,16 @@
 #include "Primitives.h"
+#include "InstancedMesh.h"
+#include "RenderQueue.h"
+#include "ShaderCache.h"
+#include "UniformBatch.h"
 
 #include "Corrade/Containers/GrowableArray.h"
-#include "Magnum/MeshTools/GenerateNormals.h"
 #include "widgets/utils.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
 namespace mc_rtc::magnum
 {
 
@@ -17,6 +24,20 @@ static void set_children_hidden(Object3D * object, bool hidden)
   }
 }
 
+Range3D transformBounds(const Matrix4 & transformation, const Range3D & bounds) noexcept
+{
+  Vector3 center = transformation.transformPoint(bounds.center());
+  Vector3 half = bounds.size() / 2.0f;
+  /* Extent of the transformed box along each world axis */
+  Vector3 extent;
+  for(size_t i = 0; i < 3; ++i)
+  {
+    extent[i] = Math::abs(transformation[0][i]) * half.x() + Math::abs(transformation[1][i]) * half.y()
+                + Math::abs(transformation[2][i]) * half.z();
+  }
+  return {center - extent, center + extent};
+}
+
 void CommonDrawable::hidden(bool hidden) noexcept
 {
   if(hidden_ == hidden) { return; }
@@ -26,13 +47,18 @@ void CommonDrawable::hidden(bool hidden) noexcept
   set_children_hidden(this, hidden);
 }
 
+void CommonDrawable::submit(RenderQueue & queue, const Matrix4 & transformationMatrix)
+{
+  queue.submit(*this, transformationMatrix);
+}
+
 ColoredDrawable::ColoredDrawable(Object3D * object,
                                  SceneGraph::DrawableGroup3D * group,
                                  Shaders::PhongGL & shader,
                                  GL::Mesh & mesh,
                                  const Color4 & color,
                                  const Containers::Optional<Color4> & ambient)
-: CommonDrawable(object, group), shader_(shader), mesh_(mesh), color_(color)
+: CommonDrawable(object, group), shader_(shader), mesh_(&mesh), color_(color)
 {
   if(ambient) { ambient_ = *ambient; }
   else { colorWithAmbient(color_); }
@@ -41,12 +67,23 @@ ColoredDrawable::ColoredDrawable(Object3D * object,
 
 void ColoredDrawable::draw_(const Matrix4 & transformationMatrix, SceneGraph::Camera3D & camera)
 {
+  if(instances_ && !transparent())
+  {
+    instances_->add(transformationMatrix, color_);
+    return;
+  }
+  if(batch_ && !transparent())
+  {
+    if(view_) { batch_->add(*view_, transformationMatrix, color_, ambient_); }
+    else { batch_->add(*mesh_, transformationMatrix, color_, ambient_); }
+    return;
+  }
   shader_.setDiffuseColor(Color4(color_))
       .setAmbientColor(ambient_)
       .setTransformationMatrix(transformationMatrix)
       .setNormalMatrix(transformationMatrix.normalMatrix())
       .setProjectionMatrix(camera.projectionMatrix())
-      .draw(mesh_);
+      .draw(*mesh_);
 }
 
 TexturedDrawable::TexturedDrawable(Object3D * object,
@@ -72,11 +109,14 @@ Sphere::Sphere(Object3D * parent,
                SceneGraph::DrawableGroup3D * group,
                Shaders::PhongGL & shader,
                GL::Mesh & mesh,
+               InstancedMesh & instances,
                Vector3 center,
                float radius,
                Color4 color)
 : ColoredDrawable(parent, group, shader, mesh, color), center_(center), radius_(radius)
 {
+  bounds({Vector3{-1.0f}, Vector3{1.0f}});
+  instanced(&instances);
   update();
 }
 
@@ -89,11 +129,14 @@ Box::Box(Object3D * parent,
          SceneGraph::DrawableGroup3D * group,
          Shaders::PhongGL & shader,
          GL::Mesh & mesh,
+         InstancedMesh & instances,
          Matrix4 pose,
          Vector3 size,
          Color4 color)
 : ColoredDrawable(parent, group, shader, mesh, color), pose_(pose), size_(size)
 {
+  bounds({Vector3{-1.0f}, Vector3{1.0f}});
+  instanced(&instances);
   update();
 }
 
@@ -102,6 +145,13 @@ void Box::update() noexcept
   setTransformation(pose_ * Matrix4::scaling(size_ / 2.0));
 }
 
+PolyhedronDrawable::PolyhedronDrawable(Object3D * parent, SceneGraph::DrawableGroup3D * group, ShaderCache & shaders)
+: CommonDrawable(parent, group),
+  shader_(shaders.get<Shaders::PhongGL>(Shaders::PhongGL::Flag::VertexColor | Shaders::PhongGL::Flag::DoubleSided)),
+  mesh_shader_(shaders.get<Shaders::MeshVisualizerGL3D>(Shaders::MeshVisualizerGL3D::Flag::Wireframe))
+{
+}
+
 void PolyhedronDrawable::draw_(const Matrix4 & transformationMatrix, SceneGraph::Camera3D & camera)
 {
   if(vertices_.isEmpty()) { return; }
@@ -127,39 +177,120 @@ void PolyhedronDrawable::draw_(const Matrix4 & transformationMatrix, SceneGraph:
 
 void PolyhedronDrawable::alpha(float) noexcept {}
 
+void PolyhedronDrawable::updateAdjacency()
+{
+  /* Vertices are duplicated to give them different colors, the copies are found by sorting the positions' bits */
+  auto key = [this](UnsignedInt i)
+  {
+    std::array<UnsignedInt, 3> out;
+    std::memcpy(out.data(), vertices_[i].position.data(), sizeof(out));
+    return out;
+  };
+  Containers::Array<UnsignedInt> order{NoInit, vertices_.size()};
+  for(UnsignedInt i = 0; i < order.size(); ++i) { order[i] = i; }
+  std::sort(order.begin(), order.end(), [&key](UnsignedInt a, UnsignedInt b) { return key(a) < key(b); });
+  auto & adj = adjacency_;
+  adj.position = Containers::Array<UnsignedInt>{NoInit, vertices_.size()};
+  UnsignedInt distinct = 0;
+  for(size_t i = 0; i < order.size(); ++i)
+  {
+    if(i == 0 || key(order[i]) != key(order[i - 1])) { ++distinct; }
+    adj.position[order[i]] = distinct - 1;
+  }
+
+  /* Faces around each distinct position, counted then filled */
+  size_t faceCount = indices_.size() / 3;
+  adj.offsets = Containers::Array<UnsignedInt>{ValueInit, distinct + 1};
+  for(size_t i = 0; i < 3 * faceCount; ++i) { adj.offsets[adj.position[indices_[i]] + 1]++; }
+  for(size_t i = 0; i < distinct; ++i) { adj.offsets[i + 1] += adj.offsets[i]; }
+  adj.faces = Containers::Array<UnsignedInt>{NoInit, adj.offsets[distinct]};
+  Containers::Array<UnsignedInt> next{NoInit, distinct};
+  for(size_t i = 0; i < distinct; ++i) { next[i] = adj.offsets[i]; }
+  for(size_t i = 0; i < 3 * faceCount; ++i) { adj.faces[next[adj.position[indices_[i]]]++] = UnsignedInt(i / 3); }
+  adj.faceNormals = Containers::Array<Vector3>{NoInit, faceCount};
+  adj.normals = Containers::Array<Vector3>{NoInit, distinct};
+}
+
+void PolyhedronDrawable::updateNormals()
+{
+  /* Every pass writes its output sequentially: face normals, then each position gathers the normals of its faces */
+  auto & adj = adjacency_;
+  for(size_t i = 0; i < adj.faceNormals.size(); ++i)
+  {
+    const Vector3 & a = vertices_[indices_[3 * i]].position;
+    const Vector3 & b = vertices_[indices_[3 * i + 1]].position;
+    const Vector3 & c = vertices_[indices_[3 * i + 2]].position;
+    /* The cross product length is twice the triangle area */
+    adj.faceNormals[i] = Math::cross(b - a, c - a);
+  }
+  for(size_t i = 0; i < adj.normals.size(); ++i)
+  {
+    Vector3 n;
+    for(UnsignedInt f = adj.offsets[i]; f < adj.offsets[i + 1]; ++f) { n += adj.faceNormals[adj.faces[f]]; }
+    float length = n.length();
+    adj.normals[i] = length > 0.0f ? n / length : Vector3::zAxis();
+  }
+  for(size_t i = 0; i < vertices_.size(); ++i) { vertices_[i].normal = adj.normals[adj.position[i]]; }
+}
+
 void PolyhedronDrawable::update(const std::vector<Eigen::Vector3d> & vertices,
                                 const std::vector<std::array<size_t, 3>> & indices,
                                 const std::vector<mc_rtc::gui::Color> & colors,
                                 const mc_rtc::gui::PolyhedronConfig & config)
 {
-  Containers::arrayResize(vertices_, vertices.size());
+  bool sameTopology = configured_ && vertices.size() == vertices_.size() && 3 * indices.size() == indices_.size();
+  for(size_t i = 0; sameTopology && i < indices.size(); ++i)
+  {
+    sameTopology = indices_[3 * i + 0] == indices[i][0] && indices_[3 * i + 1] == indices[i][1]
+                   && indices_[3 * i + 2] == indices[i][2];
+  }
+  if(!sameTopology)
+  {
+    Containers::arrayResize(vertices_, vertices.size());
+    Containers::arrayResize(indices_, 3 * indices.size());
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+      indices_[3 * i + 0] = static_cast<UnsignedInt>(indices[i][0]);
+      indices_[3 * i + 1] = static_cast<UnsignedInt>(indices[i][1]);
+      indices_[3 * i + 2] = static_cast<UnsignedInt>(indices[i][2]);
+    }
+  }
   default_color_ = convert(config.triangle_color);
+  transparent_ = false;
+  Vector3 min{Constants::inf()};
+  Vector3 max{-Constants::inf()};
+  /* Vertices sharing a position are grouped by the position bits, the groups change as soon as one of them moves */
+  bool moved = !sameTopology;
   for(size_t i = 0; i < vertices.size(); ++i)
   {
     const auto & color = i < colors.size() ? colors[i] : config.triangle_color;
-    vertices_[i] = {translation(vertices[i]), {}, convert(color)};
+    Vector3 position = translation(vertices[i]);
+    moved = moved || std::memcmp(position.data(), vertices_[i].position.data(), sizeof(Vector3)) != 0;
+    vertices_[i].position = position;
+    vertices_[i].color = convert(color);
+    transparent_ = transparent_ || color.a < 1.0;
+    min = Math::min(min, vertices_[i].position);
+    max = Math::max(max, vertices_[i].position);
   }
-  auto vertices_view = Containers::StridedArrayView1D<Vector3>(vertices_, &vertices_[0].position,
-                                                               Containers::arraySize(vertices_), sizeof(Vertex));
-  auto normals_view = Containers::StridedArrayView1D<Vector3>(vertices_, &vertices_[0].normal,
-                                                              Containers::arraySize(vertices_), sizeof(Vertex));
-  Containers::arrayResize(indices_, 3 * indices.size());
-  for(size_t i = 0; i < indices.size(); ++i)
+  bounds({min, max});
+  if(moved) { updateAdjacency(); }
+  updateNormals();
+
+  if(sameTopology)
   {
-    indices_[3 * i + 0] = static_cast<uint16_t>(indices[i][0]);
-    indices_[3 * i + 1] = static_cast<uint16_t>(indices[i][1]);
-    indices_[3 * i + 2] = static_cast<uint16_t>(indices[i][2]);
+    vertices_buffer_.setSubData(0, vertices_);
+    return;
   }
-  indices_buffer_.setData(indices_, GL::BufferUsage::DynamicDraw);
-
-  MeshTools::generateSmoothNormalsInto(indices_, vertices_view, normals_view);
   vertices_buffer_.setData(vertices_, GL::BufferUsage::DynamicDraw);
-
+  indices_buffer_.setData(indices_, GL::BufferUsage::DynamicDraw);
   mesh_.setCount(Containers::arraySize(indices_));
-  mesh_.addVertexBuffer(vertices_buffer_, 0, Shaders::PhongGL::Position{}, Shaders::PhongGL::Normal{},
-                        Shaders::PhongGL::Color4{});
-  static_assert(std::is_same_v<uint16_t, unsigned short>);
-  mesh_.setIndexBuffer(indices_buffer_, 0, MeshIndexType::UnsignedShort);
+  if(!configured_)
+  {
+    mesh_.addVertexBuffer(vertices_buffer_, 0, Shaders::PhongGL::Position{}, Shaders::PhongGL::Normal{},
+                          Shaders::PhongGL::Color4{});
+    mesh_.setIndexBuffer(indices_buffer_, 0, MeshIndexType::UnsignedInt);
+    configured_ = true;
+  }
 }
 
 } // namespace mc_rtc::magnum
@@ -2,15 +2,44 @@
 
 #include "Camera.h"
 
+#include <Magnum/GL/MeshView.h>
+#include <Magnum/Math/Range.h>
 #include <Magnum/Shaders/MeshVisualizerGL.h>
 
 #include <mc_rtc/gui/types.h>
 
 #include <memory>
+#include <tuple>
 
 namespace mc_rtc::magnum
 {
 
+struct InstancedMesh;
+struct RenderQueue;
+struct ShaderCache;
+struct UniformBatch;
+
+/** Axis-aligned bounds of \p bounds once transformed by \p transformation */
+Range3D transformBounds(const Matrix4 & transformation, const Range3D & bounds) noexcept;
+
+/** Identifies the GL state (shader, mesh and texture) used by a drawable */
+struct DrawKey
+{
+  const void * shader = nullptr;
+  const void * mesh = nullptr;
+  const void * texture = nullptr;
+
+  inline bool operator<(const DrawKey & rhs) const noexcept
+  {
+    return std::tie(shader, mesh, texture) < std::tie(rhs.shader, rhs.mesh, rhs.texture);
+  }
+
+  inline bool operator!=(const DrawKey & rhs) const noexcept
+  {
+    return shader != rhs.shader || mesh != rhs.mesh || texture != rhs.texture;
+  }
+};
+
 class CommonDrawable : public Object3D, public SceneGraph::Drawable3D
 {
 public:
@@ -27,6 +56,20 @@ public:
 
   virtual void alpha(float alpha) noexcept = 0;
 
+  /** Add this drawable to the render queue, composite drawables submit their parts instead */
+  virtual void submit(RenderQueue & queue, const Matrix4 & transformationMatrix);
+
+  /** True if the drawable needs to be blended with what is behind it */
+  virtual bool transparent() const noexcept { return false; }
+
+  /** GL state used by this drawable */
+  virtual DrawKey key() const noexcept { return {}; }
+
+  /** Local bounds of the drawable, drawables without bounds are never culled */
+  inline const Containers::Optional<Range3D> & bounds() const noexcept { return bounds_; }
+
+  inline void bounds(const Range3D & bounds) noexcept { bounds_ = bounds; }
+
   inline void draw(const Matrix4 & transformationMatrix, SceneGraph::Camera3D & camera) final
   {
     if(!hidden_) { draw_(transformationMatrix, camera); }
@@ -35,6 +78,7 @@ public:
 private:
   SceneGraph::DrawableGroup3D * group_;
   bool hidden_ = false;
+  Containers::Optional<Range3D> bounds_;
 };
 
 class ColoredDrawable : public CommonDrawable
@@ -72,13 +116,32 @@ public:
     ambient_.a() = 0.0f;
   }
 
+  inline bool transparent() const noexcept override { return color_.a() < 1.0f; }
+
+  inline DrawKey key() const noexcept override { return {&shader_, view_ ? &view_->mesh() : mesh_, nullptr}; }
+
+  /** Change the drawn mesh, used to switch between levels of detail */
+  inline void mesh(GL::Mesh & mesh) noexcept { mesh_ = &mesh; }
+
+  /** When set, the drawable is added to \p instances instead of being drawn on its own while it is opaque */
+  inline void instanced(InstancedMesh * instances) noexcept { instances_ = instances; }
+
+  /** When set, the drawable is added to \p batch instead of being drawn on its own while it is opaque */
+  inline void batched(UniformBatch * batch) noexcept { batch_ = batch; }
+
+  /** When set, the batched draws use \p view of a \ref MergedMesh instead of the drawn mesh */
+  inline void view(GL::MeshView * view) noexcept { view_ = view; }
+
 protected:
   void draw_(const Matrix4 & transformationMatrix, SceneGraph::Camera3D & camera) override;
 
   Shaders::PhongGL & shader_;
-  GL::Mesh & mesh_;
+  GL::Mesh * mesh_;
   Color4 color_;
   Color4 ambient_;
+  InstancedMesh * instances_ = nullptr;
+  UniformBatch * batch_ = nullptr;
+  GL::MeshView * view_ = nullptr;
 };
 
 class TexturedDrawable : public CommonDrawable
@@ -92,6 +155,10 @@ public:
 
   inline void alpha(float alpha) noexcept final { alpha_ = alpha; }
 
+  inline bool transparent() const noexcept final { return alpha_ < 1.0f; }
+
+  inline DrawKey key() const noexcept final { return {&shader_, &mesh_, &texture_}; }
+
 private:
   void draw_(const Matrix4 & transformationMatrix, SceneGraph::Camera3D & camera) override;
 
@@ -108,6 +175,7 @@ public:
                   SceneGraph::DrawableGroup3D * group,
                   Shaders::PhongGL & shader,
                   GL::Mesh & mesh,
+                  InstancedMesh & instances,
                   Vector3 center,
                   float radius,
                   Color4 color);
@@ -139,6 +207,7 @@ public:
                SceneGraph::DrawableGroup3D * group,
                Shaders::PhongGL & shader,
                GL::Mesh & mesh,
+               InstancedMesh & instances,
                Matrix4 pose,
                Vector3 size,
                Color4 color);
@@ -169,7 +238,7 @@ using EllipsoidPtr = std::shared_ptr<Ellipsoid>;
 class PolyhedronDrawable : public CommonDrawable
 {
 public:
-  using CommonDrawable::CommonDrawable;
+  PolyhedronDrawable(Object3D * parent, SceneGraph::DrawableGroup3D * group, ShaderCache & shaders);
 
   bool draw_wireframe() const noexcept { return draw_wireframe_; }
   void draw_wireframe(bool b) noexcept { draw_wireframe_ = b; }
@@ -178,29 +247,57 @@ public:
 
   void alpha(float alpha) noexcept override;
 
+  inline bool transparent() const noexcept override { return transparent_; }
+
+  inline DrawKey key() const noexcept override { return {&shader_, &mesh_, nullptr}; }
+
+  /** Update the polyhedron
+   *
+   * When the triangles are the same as in the previous update the vertex data is rewritten in the existing buffer and
+   * the index buffer is left untouched
+   */
   void update(const std::vector<Eigen::Vector3d> & vertices,
               const std::vector<std::array<size_t, 3>> & indices,
               const std::vector<mc_rtc::gui::Color> & colors,
               const mc_rtc::gui::PolyhedronConfig & config);
 
 private:
+  /** Rebuild \ref adjacency_ from the current vertices and indices */
+  void updateAdjacency();
+
+  /** Area-weighted smooth normals, vertices that share a position get the same normal */
+  void updateNormals();
+
   struct Vertex
   {
     Vector3 position;
     Vector3 normal;
     Color4 color;
   };
+  /** Faces around each distinct vertex position, rebuilt when the topology changes or a vertex moves */
+  struct Adjacency
+  {
+    /** Distinct position of each vertex */
+    Containers::Array<UnsignedInt> position;
+    /** The faces around distinct position i are faces[offsets[i]] to faces[offsets[i + 1]] */
+    Containers::Array<UnsignedInt> offsets;
+    Containers::Array<UnsignedInt> faces;
+    /** Normal of each face, then of each distinct position */
+    Containers::Array<Vector3> faceNormals;
+    Containers::Array<Vector3> normals;
+  };
   bool draw_wireframe_ = false;
+  bool transparent_ = false;
   Containers::Array<Vertex> vertices_;
-  Containers::Array<uint16_t> indices_;
+  Containers::Array<UnsignedInt> indices_;
+  Adjacency adjacency_;
+  bool configured_ = false;
   GL::Buffer vertices_buffer_;
   GL::Buffer indices_buffer_;
   GL::Mesh mesh_;
   Color4 default_color_;
-  Shaders::PhongGL shader_ = Shaders::PhongGL{Shaders::PhongGL::Configuration{}.setFlags(
-      Shaders::PhongGL::Flag::VertexColor | Shaders::PhongGL::Flag::DoubleSided)};
-  Shaders::MeshVisualizerGL3D mesh_shader_ = Shaders::MeshVisualizerGL3D{
-      Shaders::MeshVisualizerGL3D::Configuration{}.setFlags(Shaders::MeshVisualizerGL3D::Flag::Wireframe)};
+  Shaders::PhongGL & shader_;
+  Shaders::MeshVisualizerGL3D & mesh_shader_;
 };
 
 using PolyhedronPtr = std::shared_ptr<PolyhedronDrawable>;
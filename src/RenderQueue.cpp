@@ -0,0 +1,75 @@
+#include "RenderQueue.h"
+
+#include <Magnum/Math/Intersection.h>
+
+#include <algorithm>
+
+namespace mc_rtc::magnum
+{
+
+void RenderQueue::clear(const SceneGraph::Camera3D & camera)
+{
+  opaque_.clear();
+  transparent_.clear();
+  frustum_ = Frustum::fromMatrix(camera.projectionMatrix());
+  projection_ = camera.projectionMatrix();
+  viewportHeight_ = static_cast<float>(std::max(camera.viewport().y(), 1));
+  culled_ = 0;
+}
+
+bool RenderQueue::visible(const Matrix4 & transformationMatrix, const Range3D & bounds) const noexcept
+{
+  Vector3 center = transformationMatrix.transformPoint(bounds.center());
+  float radius = (bounds.size() / 2.0f).length() * Math::sqrt(transformationMatrix.scalingSquared().max());
+  return Math::Intersection::sphereFrustum(center, radius, frustum_);
+}
+
+float RenderQueue::pixelSize(const Vector3 & point) const noexcept
+{
+  /* Clip-space w is the distance to the camera plane for a perspective projection and 1 for an orthographic one */
+  float w = projection_[2][3] * point.z() + projection_[3][3];
+  return 2.0f * Math::abs(w) / (projection_[1][1] * viewportHeight_);
+}
+
+void RenderQueue::submit(CommonDrawable & drawable, const Matrix4 & transformationMatrix)
+{
+  if(drawable.hidden()) { return; }
+  if(drawable.bounds() && !visible(transformationMatrix, *drawable.bounds()))
+  {
+    culled_++;
+    return;
+  }
+  auto & entries = drawable.transparent() ? transparent_ : opaque_;
+  entries.push_back({&drawable, transformationMatrix, drawable.key(), transformationMatrix.translation().z()});
+}
+
+void RenderQueue::submit(SceneGraph::DrawableGroup3D & group, SceneGraph::Camera3D & camera)
+{
+  const Matrix4 & cameraMatrix = camera.cameraMatrix();
+  for(size_t i = 0; i < group.size(); ++i)
+  {
+    auto & drawable = group[i];
+    Matrix4 transformation = cameraMatrix * drawable.object().absoluteTransformationMatrix();
+    if(auto * common = dynamic_cast<CommonDrawable *>(&drawable)) { common->submit(*this, transformation); }
+    else { drawable.draw(transformation, camera); }
+  }
+}
+
+void RenderQueue::drawOpaque(SceneGraph::Camera3D & camera)
+{
+  std::sort(opaque_.begin(), opaque_.end(),
+            [](const Entry & a, const Entry & b)
+            {
+              if(a.key != b.key) { return a.key < b.key; }
+              return a.depth > b.depth;
+            });
+  for(auto & e : opaque_) { e.drawable->draw_(e.transformation, camera); }
+}
+
+void RenderQueue::drawTransparent(SceneGraph::Camera3D & camera)
+{
+  std::sort(transparent_.begin(), transparent_.end(), [](const Entry & a, const Entry & b) { return a.depth < b.depth; });
+  for(auto & e : transparent_) { e.drawable->draw_(e.transformation, camera); }
+}
+
+} // namespace mc_rtc::magnum
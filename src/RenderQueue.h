@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Primitives.h"
+
+#include <Magnum/Math/Frustum.h>
+
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+/** Collects the drawables of a frame and draws them in an order that minimizes state changes
+ *
+ * Opaque drawables are grouped by shader/mesh/texture and drawn front-to-back within a group, transparent drawables
+ * are drawn back-to-front after everything else. The storage is kept between frames.
+ */
+struct RenderQueue
+{
+  /** Remove all drawables from the queue and cull against \p camera's frustum, keeps the allocated storage */
+  void clear(const SceneGraph::Camera3D & camera);
+
+  /** Add a drawable, \p transformationMatrix is the drawable's transformation relative to the camera
+   *
+   * Drawables whose bounds are outside of the view frustum are dropped
+   */
+  void submit(CommonDrawable & drawable, const Matrix4 & transformationMatrix);
+
+  /** True if \p bounds transformed by \p transformationMatrix (relative to the camera) intersects the view frustum */
+  bool visible(const Matrix4 & transformationMatrix, const Range3D & bounds) const noexcept;
+
+  /** Size of a pixel at \p point (relative to the camera), in the same unit as \p point
+   *
+   * Uses the projection and viewport of the last \ref clear
+   */
+  float pixelSize(const Vector3 & point) const noexcept;
+
+  /** Count \p count drawables as culled, used by drawables that are culled as a group */
+  inline void culled(size_t count) noexcept { culled_ += count; }
+
+  /** Number of drawables culled since the last \ref clear */
+  inline size_t culled() const noexcept { return culled_; }
+
+  /** Number of drawables in the queue */
+  inline size_t drawn() const noexcept { return opaque_.size() + transparent_.size(); }
+
+  /** Add every drawable of \p group
+   *
+   * Drawables that are not a \ref CommonDrawable (e.g. robots or the grid) are drawn immediately, robots use this
+   * opportunity to submit their bodies to the queue
+   */
+  void submit(SceneGraph::DrawableGroup3D & group, SceneGraph::Camera3D & camera);
+
+  /** Draw the opaque drawables */
+  void drawOpaque(SceneGraph::Camera3D & camera);
+
+  /** Draw the transparent drawables, should be called after everything opaque has been drawn */
+  void drawTransparent(SceneGraph::Camera3D & camera);
+
+private:
+  struct Entry
+  {
+    CommonDrawable * drawable;
+    Matrix4 transformation;
+    DrawKey key;
+    /** View-space depth, larger is closer to the camera */
+    float depth;
+  };
+  std::vector<Entry> opaque_;
+  std::vector<Entry> transparent_;
+  Frustum frustum_;
+  Matrix4 projection_;
+  float viewportHeight_ = 1.0f;
+  size_t culled_ = 0;
+};
+
+} // namespace mc_rtc::magnum
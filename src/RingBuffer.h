@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+/** Fixed-capacity FIFO, pushing into a full buffer overwrites the oldest element
+ *
+ * Storage grows with the number of elements up to the capacity so short histories stay cheap.
+ */
+template<typename T>
+struct RingBuffer
+{
+  explicit RingBuffer(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+  /** Maximum number of elements kept */
+  inline size_t capacity() const noexcept { return capacity_; }
+
+  inline size_t size() const noexcept { return data_.size(); }
+
+  inline bool empty() const noexcept { return data_.empty(); }
+
+  inline bool full() const noexcept { return data_.size() == capacity_; }
+
+  /** Element \p i, 0 is the oldest */
+  inline const T & operator[](size_t i) const noexcept { return data_[(head_ + i) % data_.size()]; }
+
+  inline const T & front() const noexcept { return (*this)[0]; }
+
+  inline const T & back() const noexcept { return (*this)[size() - 1]; }
+
+  void push_back(const T & value)
+  {
+    if(!full()) { data_.push_back(value); }
+    else
+    {
+      data_[head_] = value;
+      head_ = (head_ + 1) % capacity_;
+    }
+  }
+
+  inline void clear() noexcept
+  {
+    data_.clear();
+    head_ = 0;
+  }
+
+private:
+  size_t capacity_;
+  std::vector<T> data_;
+  /** Index of the oldest element in data_ */
+  size_t head_ = 0;
+};
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <Magnum/Tags.h>
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+/** Owns one instance of every shader variant requested by the drawables and widgets
+ *
+ * Shaders are keyed by their type and flags, users get a reference to the shared instance so creating a new element
+ * never compiles a shader once the variant has been seen. Since the instances are shared, users must set every
+ * uniform they rely on before drawing.
+ *
+ * The cache also drives asynchronous compilation: shaders started with \ref prepare or \ref compile are compiled and
+ * linked in parallel (using KHR_parallel_shader_compile when the driver supports it) and only become usable once \ref
+ * update returns true.
+ */
+struct ShaderCache
+{
+  /** Get the shader of type \p Shader with \p flags
+   *
+   * Unknown variants are compiled immediately, variants started with \ref prepare might still be compiling
+   */
+  template<typename Shader>
+  Shader & get(typename Shader::Flags flags = {})
+  {
+    auto key = makeKey<Shader>(flags);
+    auto it = shaders_.find(key);
+    if(it == shaders_.end())
+    {
+      it = shaders_.emplace(key, std::make_unique<Holder<Shader>>(typename Shader::Configuration{}.setFlags(flags)))
+               .first;
+    }
+    return static_cast<Holder<Shader> &>(*it->second).shader;
+  }
+
+  /** Start compiling the variant of \p Shader with \p flags without waiting for the result */
+  template<typename Shader>
+  void prepare(typename Shader::Flags flags = {})
+  {
+    auto key = makeKey<Shader>(flags);
+    if(shaders_.count(key)) { return; }
+    auto & holder = *shaders_.emplace(key, std::make_unique<Holder<Shader>>(Magnum::NoCreate)).first->second;
+    compile(static_cast<Holder<Shader> &>(holder).shader, typename Shader::Configuration{}.setFlags(flags));
+  }
+
+  /** Asynchronously compile \p shader (created with NoCreate) from \p configuration
+   *
+   * \p setup is called once the shader is ready, typically to set uniforms that never change
+   */
+  template<typename Shader, typename Setup = std::nullptr_t>
+  void compile(Shader & shader, const typename Shader::Configuration & configuration, Setup setup = nullptr)
+  {
+    std::function<void(Shader &)> setupFn;
+    if constexpr(!std::is_same_v<Setup, std::nullptr_t>) { setupFn = std::move(setup); }
+    auto state = std::make_shared<typename Shader::CompileState>(Shader::compile(configuration));
+    pending_.push_back({[state]() { return state->isLinkFinished(); },
+                        [state, &shader, setup = std::move(setupFn)]()
+                        {
+                          shader = Shader{std::move(*state)};
+                          if(setup) { setup(shader); }
+                        }});
+  }
+
+  /** Finish the shaders whose compilation is done
+   *
+   * \returns True if every shader is ready to use
+   */
+  bool update()
+  {
+    for(size_t i = 0; i < pending_.size();)
+    {
+      if(pending_[i].finished())
+      {
+        pending_[i].finalize();
+        pending_.erase(pending_.begin() + static_cast<std::ptrdiff_t>(i));
+      }
+      else { ++i; }
+    }
+    return pending_.empty();
+  }
+
+  /** Number of shaders still compiling */
+  inline size_t pending() const noexcept { return pending_.size(); }
+
+  /** Number of shader variants in the cache */
+  inline size_t size() const noexcept { return shaders_.size(); }
+
+private:
+  using Key = std::pair<std::type_index, unsigned long long>;
+
+  template<typename Shader>
+  static Key makeKey(typename Shader::Flags flags)
+  {
+    return {std::type_index(typeid(Shader)),
+            static_cast<unsigned long long>(static_cast<typename Shader::Flags::UnderlyingType>(flags))};
+  }
+
+  struct HolderBase
+  {
+    virtual ~HolderBase() = default;
+  };
+
+  template<typename Shader>
+  struct Holder : public HolderBase
+  {
+    Holder(Magnum::NoCreateT) : shader(Magnum::NoCreate) {}
+
+    template<typename Configuration>
+    Holder(const Configuration & configuration) : shader(configuration)
+    {
+    }
+
+    Shader shader;
+  };
+
+  struct Pending
+  {
+    std::function<bool()> finished;
+    std::function<void()> finalize;
+  };
+
+  std::map<Key, std::unique_ptr<HolderBase>> shaders_;
+  std::vector<Pending> pending_;
+};
+
+} // namespace mc_rtc::magnum
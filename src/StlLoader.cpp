@@ -0,0 +1,162 @@
+#include "StlLoader.h"
+
+#include <Corrade/Utility/Path.h>
+#include <Magnum/Math/Vector3.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+namespace
+{
+
+struct Vertex
+{
+  Vector3 position;
+  Vector3 normal;
+};
+
+/** Binary STL: 80 bytes header, triangle count, then 50 bytes per triangle */
+constexpr size_t HeaderSize = 84;
+constexpr size_t TriangleSize = 50;
+
+/** Read the corners of the binary STL triangles in \p data */
+bool readBinary(Containers::ArrayView<const char> data, std::vector<Vector3> & corners)
+{
+  if(data.size() < HeaderSize) { return false; }
+  UnsignedInt count;
+  std::memcpy(&count, data.data() + 80, sizeof(count));
+  if(data.size() < HeaderSize + size_t(count) * TriangleSize) { return false; }
+  corners.resize(3 * size_t(count));
+  const char * triangle = data.data() + HeaderSize;
+  for(size_t i = 0; i < count; ++i, triangle += TriangleSize)
+  {
+    /* Skip the stored normal */
+    std::memcpy(&corners[3 * i], triangle + 12, 3 * sizeof(Vector3));
+  }
+  return true;
+}
+
+/** Read the corners of the ASCII STL facets in \p data */
+bool readAscii(Containers::ArrayView<const char> data, std::vector<Vector3> & corners)
+{
+  /* Copied to get a null-terminated string for strtof */
+  std::string text(data.data(), data.size());
+  const char * c = text.c_str();
+  while((c = std::strstr(c, "vertex")) != nullptr)
+  {
+    c += 6;
+    Vector3 p;
+    for(size_t i = 0; i < 3; ++i)
+    {
+      char * end;
+      p[i] = std::strtof(c, &end);
+      if(end == c) { return false; }
+      c = end;
+    }
+    corners.push_back(p);
+  }
+  return !corners.empty() && corners.size() % 3 == 0;
+}
+
+/** Hash of a vertex bit pattern, -0.0f must have been replaced by 0.0f */
+inline size_t hash(const Vertex & v)
+{
+  UnsignedInt bits[6];
+  std::memcpy(bits, &v, sizeof(bits));
+  size_t h = 0;
+  for(UnsignedInt b : bits) { h = (h ^ b) * 0x9e3779b97f4a7c15ull; }
+  return h ^ (h >> 29);
+}
+
+} // namespace
+
+bool isStl(const std::string & path)
+{
+  if(path.size() < 4) { return false; }
+  std::string ext = path.substr(path.size() - 4);
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+  return ext == ".stl";
+}
+
+Containers::Optional<Trade::MeshData> loadStl(const std::string & path)
+{
+  auto data = Utility::Path::mapRead(path);
+  if(!data) { return {}; }
+  std::vector<Vector3> corners;
+  /* Binary files may also start with "solid" so the size check comes first */
+  bool binary = data->size() >= HeaderSize
+                && [&]()
+                {
+                  UnsignedInt count;
+                  std::memcpy(&count, data->data() + 80, sizeof(count));
+                  return data->size() == HeaderSize + size_t(count) * TriangleSize;
+                }();
+  if(binary) { binary = readBinary(*data, corners); }
+  if(!binary && !readAscii(*data, corners)) { return {}; }
+  if(corners.empty()) { return {}; }
+
+  /* Facet normals, computed in a flat loop the compiler can vectorize */
+  size_t triangles = corners.size() / 3;
+  std::vector<Vector3> normals(triangles);
+  for(size_t i = 0; i < triangles; ++i)
+  {
+    const Vector3 & a = corners[3 * i];
+    normals[i] = Math::cross(corners[3 * i + 1] - a, corners[3 * i + 2] - a);
+  }
+  for(auto & n : normals)
+  {
+    float length = n.length();
+    n = length > 0.0f ? n / length : Vector3::zAxis();
+  }
+
+  /* Weld identical position/normal pairs with an open addressing hash table */
+  size_t capacity = 1;
+  while(capacity < 2 * corners.size()) { capacity *= 2; }
+  constexpr UnsignedInt Empty = ~UnsignedInt{0};
+  std::vector<UnsignedInt> table(capacity, Empty);
+  std::vector<Vertex> vertices;
+  vertices.reserve(corners.size());
+  Containers::Array<char> indexData{NoInit, corners.size() * sizeof(UnsignedInt)};
+  auto indices = Containers::arrayCast<UnsignedInt>(indexData);
+  for(size_t i = 0; i < corners.size(); ++i)
+  {
+    Vertex v{corners[i], normals[i / 3]};
+    for(size_t j = 0; j < 3; ++j)
+    {
+      if(v.position[j] == 0.0f) { v.position[j] = 0.0f; }
+      if(v.normal[j] == 0.0f) { v.normal[j] = 0.0f; }
+    }
+    size_t slot = hash(v) & (capacity - 1);
+    while(table[slot] != Empty
+          && (vertices[table[slot]].position != v.position || vertices[table[slot]].normal != v.normal))
+    {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    if(table[slot] == Empty)
+    {
+      table[slot] = static_cast<UnsignedInt>(vertices.size());
+      vertices.push_back(v);
+    }
+    indices[i] = table[slot];
+  }
+
+  Containers::Array<char> vertexData{NoInit, vertices.size() * sizeof(Vertex)};
+  std::memcpy(vertexData.data(), vertices.data(), vertexData.size());
+  auto view = Containers::arrayCast<const Vertex>(vertexData);
+  Trade::MeshIndexData indexView{indices};
+  Trade::MeshAttributeData positions{Trade::MeshAttribute::Position,
+                                     Containers::stridedArrayView(view).slice(&Vertex::position)};
+  Trade::MeshAttributeData normalsView{Trade::MeshAttribute::Normal,
+                                       Containers::stridedArrayView(view).slice(&Vertex::normal)};
+  return Trade::MeshData{MeshPrimitive::Triangles, std::move(indexData), indexView, std::move(vertexData),
+                         Containers::Array<Trade::MeshAttributeData>{InPlaceInit, {positions, normalsView}},
+                         static_cast<UnsignedInt>(vertices.size())};
+}
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Camera.h"
+
+#include <string>
+
+namespace mc_rtc::magnum
+{
+
+/** True if \p path has a .stl extension (case insensitive) */
+bool isStl(const std::string & path);
+
+/** Load a binary or ASCII STL file
+ *
+ * This is much faster than going through AssimpImporter for the simple meshes found in robot descriptions: the file
+ * is memory-mapped, facet normals are computed from the vertices (the normals stored in the file are often wrong)
+ * and identical vertices of a facet's neighbours are welded. The result is an indexed mesh with interleaved
+ * Position and Normal attributes.
+ *
+ * \returns NullOpt if the file cannot be read or is not a valid STL file
+ */
+Containers::Optional<Trade::MeshData> loadStl(const std::string & path);
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace mc_rtc::magnum
+{
+
+/** Lock-free single producer/single consumer triple buffer
+ *
+ * The producer writes into \ref back() and calls \ref publish(), the consumer calls \ref consume() and reads \ref
+ * front(). Neither side ever waits for the other, the consumer always gets the latest published value.
+ */
+template<typename T>
+struct TripleBuffer
+{
+  /** Buffer owned by the producer */
+  inline T & back() noexcept { return buffers_[back_]; }
+
+  /** Make the back buffer available to the consumer
+   *
+   * \returns True if the previously published value was never consumed
+   */
+  inline bool publish() noexcept
+  {
+    uint8_t previous = middle_.exchange(back_ | dirty_bit, std::memory_order_acq_rel);
+    back_ = previous & index_mask;
+    return previous & dirty_bit;
+  }
+
+  /** Fetch the latest published value if there is one
+   *
+   * \returns True if \ref front() now holds a value that was not seen before
+   */
+  inline bool consume() noexcept
+  {
+    if(!(middle_.load(std::memory_order_relaxed) & dirty_bit)) { return false; }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+
+  /** True if a published value is waiting for the consumer */
+  inline bool pending() const noexcept { return middle_.load(std::memory_order_relaxed) & dirty_bit; }
+
+  /** Buffer owned by the consumer */
+  inline T & front() noexcept { return buffers_[front_]; }
+
+private:
+  static constexpr uint8_t dirty_bit = 0x4;
+  static constexpr uint8_t index_mask = 0x3;
+  T buffers_[3];
+  uint8_t back_ = 0;
+  std::atomic<uint8_t> middle_{1};
+  uint8_t front_ = 2;
+};
+
+} // namespace mc_rtc::magnum
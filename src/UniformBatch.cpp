@@ -0,0 +1,124 @@
+#include "UniformBatch.h"
+
+#include <Corrade/Containers/Iterable.h>
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Extensions.h>
+#include <Magnum/Shaders/Generic.h>
+#include <Magnum/Shaders/Phong.h>
+
+#include <algorithm>
+
+namespace mc_rtc::magnum
+{
+
+UniformBatch::UniformBatch(ShaderCache & shaders) : multiDraw_(multiDrawSupported())
+{
+  Shaders::PhongGL::Flags flags = Shaders::PhongGL::Flag::UniformBuffers;
+  if(multiDraw_) { flags |= Shaders::PhongGL::Flag::MultiDraw; }
+  shaders.compile(shader_, Shaders::PhongGL::Configuration{}
+                               .setFlags(flags)
+                               .setLightCount(1)
+                               .setMaterialCount(DrawCount)
+                               .setDrawCount(DrawCount));
+  lightBuffer_.setData({Shaders::PhongLightUniform{}}, GL::BufferUsage::StaticDraw);
+  transformations_.resize(DrawCount);
+  drawUniforms_.resize(DrawCount);
+  materials_.resize(DrawCount);
+  views_.reserve(DrawCount);
+}
+
+bool UniformBatch::supported()
+{
+#ifdef MAGNUM_TARGET_GLES2
+  return false;
+#elif defined(MAGNUM_TARGET_GLES)
+  return true;
+#else
+  return GL::Context::current().isExtensionSupported<GL::Extensions::ARB::uniform_buffer_object>();
+#endif
+}
+
+bool UniformBatch::multiDrawSupported()
+{
+#ifdef MAGNUM_TARGET_GLES
+  /* Multi-draw is only an extension on ES, keep the simpler path there */
+  return false;
+#else
+  return supported()
+         && GL::Context::current().isExtensionSupported<GL::Extensions::ARB::shader_draw_parameters>();
+#endif
+}
+
+void UniformBatch::add(GL::Mesh & mesh, const Matrix4 & transformation, const Color4 & diffuse, const Color4 & ambient)
+{
+  draws_.push_back({&mesh, nullptr, transformation, diffuse, ambient});
+}
+
+void UniformBatch::add(GL::MeshView & view,
+                       const Matrix4 & transformation,
+                       const Color4 & diffuse,
+                       const Color4 & ambient)
+{
+  draws_.push_back({&view.mesh(), &view, transformation, diffuse, ambient});
+}
+
+void UniformBatch::draw(const Matrix4 & projection)
+{
+  drawn_ = draws_.size();
+  calls_ = 0;
+  if(draws_.empty()) { return; }
+  projectionBuffer_.setData({Shaders::ProjectionUniform3D{}.setProjectionMatrix(projection)},
+                            GL::BufferUsage::StreamDraw);
+  shader_.bindProjectionBuffer(projectionBuffer_)
+      .bindLightBuffer(lightBuffer_)
+      .bindTransformationBuffer(transformationBuffer_)
+      .bindDrawBuffer(drawBuffer_)
+      .bindMaterialBuffer(materialBuffer_);
+  for(size_t start = 0; start < draws_.size();)
+  {
+    /* A chunk holds either views of a single merged mesh or standalone meshes, the render queue sorts the draws by
+     * mesh so the views of a merged mesh are consecutive */
+    auto chunkMesh = [](const Draw & d) { return d.view ? d.mesh : nullptr; };
+    GL::Mesh * merged = chunkMesh(draws_[start]);
+    size_t count = 1;
+    while(count < DrawCount && start + count < draws_.size() && chunkMesh(draws_[start + count]) == merged) { ++count; }
+    for(size_t i = 0; i < count; ++i)
+    {
+      const auto & d = draws_[start + i];
+      transformations_[i].setTransformationMatrix(d.transformation);
+      drawUniforms_[i].setNormalMatrix(d.transformation.normalMatrix()).setMaterialId(static_cast<UnsignedInt>(i));
+      materials_[i]
+          .setDiffuseColor(d.diffuse)
+          .setAmbientColor(d.ambient)
+          .setSpecularColor(0xffffff00_rgbaf)
+          .setShininess(80.0f);
+    }
+    /* The buffers are always uploaded in full as the shader expects DrawCount elements */
+    transformationBuffer_.setData(Containers::arrayView(transformations_.data(), transformations_.size()),
+                                  GL::BufferUsage::StreamDraw);
+    drawBuffer_.setData(Containers::arrayView(drawUniforms_.data(), drawUniforms_.size()), GL::BufferUsage::StreamDraw);
+    materialBuffer_.setData(Containers::arrayView(materials_.data(), materials_.size()), GL::BufferUsage::StreamDraw);
+    if(merged && multiDraw_)
+    {
+      views_.clear();
+      for(size_t i = 0; i < count; ++i) { views_.emplace_back(*draws_[start + i].view); }
+      shader_.setDrawOffset(0).draw(Containers::arrayView(views_.data(), views_.size()));
+      calls_++;
+    }
+    else
+    {
+      for(size_t i = 0; i < count; ++i)
+      {
+        const auto & d = draws_[start + i];
+        shader_.setDrawOffset(static_cast<UnsignedInt>(i));
+        if(d.view) { shader_.draw(*d.view); }
+        else { shader_.draw(*d.mesh); }
+      }
+      calls_ += count;
+    }
+    start += count;
+  }
+  draws_.clear();
+}
+
+} // namespace mc_rtc::magnum
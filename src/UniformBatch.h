@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Camera.h"
+#include "ShaderCache.h"
+
+#include <Corrade/Containers/Reference.h>
+#include <Magnum/GL/Buffer.h>
+#include <Magnum/GL/MeshView.h>
+#include <Magnum/Shaders/PhongGL.h>
+
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+/** Draws opaque colored meshes with a uniform buffer Phong shader
+ *
+ * Transformations and materials of all the meshes added during a frame are uploaded in a few buffer updates, each
+ * draw then only selects its slot with \ref Shaders::PhongGL::setDrawOffset() instead of setting five uniforms.
+ *
+ * Consecutive views of the same \ref MergedMesh are drawn with a single multi-draw call per chunk of \ref DrawCount
+ * draws when the context supports it.
+ */
+struct UniformBatch
+{
+  explicit UniformBatch(ShaderCache & shaders);
+
+  /** True if the current GL context supports uniform buffers */
+  static bool supported();
+
+  /** True if the current GL context supports multi-draw with uniform buffers */
+  static bool multiDrawSupported();
+
+  /** Add a draw, \p transformation is relative to the camera */
+  void add(GL::Mesh & mesh, const Matrix4 & transformation, const Color4 & diffuse, const Color4 & ambient);
+
+  /** Add a draw of \p view, a part of a \ref MergedMesh */
+  void add(GL::MeshView & view, const Matrix4 & transformation, const Color4 & diffuse, const Color4 & ambient);
+
+  /** Draw everything added since the last call and clear the batch */
+  void draw(const Matrix4 & projection);
+
+  /** Number of meshes drawn by the last \ref draw call */
+  inline size_t drawn() const noexcept { return drawn_; }
+
+  /** Number of draw calls issued by the last \ref draw call */
+  inline size_t calls() const noexcept { return calls_; }
+
+private:
+  /** Number of draws uploaded at once, this must fit in the minimum guaranteed uniform block size */
+  static constexpr UnsignedInt DrawCount = 64;
+
+  struct Draw
+  {
+    /** For views, the merged mesh */
+    GL::Mesh * mesh;
+    GL::MeshView * view;
+    Matrix4 transformation;
+    Color4 diffuse;
+    Color4 ambient;
+  };
+
+  bool multiDraw_;
+  Shaders::PhongGL shader_{NoCreate};
+  GL::Buffer projectionBuffer_;
+  GL::Buffer lightBuffer_;
+  GL::Buffer transformationBuffer_;
+  GL::Buffer drawBuffer_;
+  GL::Buffer materialBuffer_;
+  std::vector<Draw> draws_;
+  std::vector<Shaders::TransformationUniform3D> transformations_;
+  std::vector<Shaders::PhongDrawUniform> drawUniforms_;
+  std::vector<Shaders::PhongMaterialUniform> materials_;
+  std::vector<Containers::Reference<GL::MeshView>> views_;
+  size_t drawn_ = 0;
+  size_t calls_ = 0;
+};
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,30 @@
+#include "UploadQueue.h"
+
+#include <algorithm>
+
+namespace mc_rtc::magnum
+{
+
+void UploadQueue::push(size_t bytes, std::function<void()> task)
+{
+  tasks_.push_back({bytes, std::move(task)});
+  std::push_heap(tasks_.begin(), tasks_.end());
+  bytes_ += bytes;
+}
+
+bool UploadQueue::run(Budget budget)
+{
+  auto start = std::chrono::steady_clock::now();
+  while(!tasks_.empty())
+  {
+    std::pop_heap(tasks_.begin(), tasks_.end());
+    Task task = std::move(tasks_.back());
+    tasks_.pop_back();
+    bytes_ -= task.bytes;
+    task.run();
+    if(std::chrono::steady_clock::now() - start >= budget) { break; }
+  }
+  return !tasks_.empty();
+}
+
+} // namespace mc_rtc::magnum
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace mc_rtc::magnum
+{
+
+/** GPU uploads waiting to be run on the render thread
+ *
+ * Uploads are spread over several frames: every frame runs the largest pending uploads until its time budget is spent
+ * so that loading new meshes never stalls the rendering for long.
+ */
+struct UploadQueue
+{
+  using Budget = std::chrono::duration<float, std::milli>;
+
+  /** Queue \p task, \p bytes estimates the size of the upload and is used to schedule the largest uploads first */
+  void push(size_t bytes, std::function<void()> task);
+
+  /** Run uploads until \p budget is spent, at least one upload runs per call
+   *
+   * \returns True if uploads remain
+   */
+  bool run(Budget budget);
+
+  /** Number of uploads waiting */
+  inline size_t pending() const noexcept { return tasks_.size(); }
+
+  /** Estimated number of bytes waiting to be uploaded */
+  inline size_t bytes() const noexcept { return bytes_; }
+
+private:
+  struct Task
+  {
+    size_t bytes;
+    std::function<void()> run;
+
+    inline bool operator<(const Task & rhs) const noexcept { return bytes < rhs.bytes; }
+  };
+  /** Max-heap on the task size */
+  std::vector<Task> tasks_;
+  size_t bytes_ = 0;
+};
+
+} // namespace mc_rtc::magnum
@@ -1,9 +1,6 @@
 #include "Polygon.h"
 
-#include <Corrade/Containers/GrowableArray.h>
-
-#include <Magnum/MeshTools/CompileLines.h>
-#include <Magnum/MeshTools/GenerateLines.h>
+#include <cstring>
 
 namespace mc_rtc::magnum
 {
@@ -11,55 +8,113 @@ namespace mc_rtc::magnum
 namespace
 {
 
-constexpr Trade::MeshAttributeData AttributeData3DWireframe[]{
-    Trade::MeshAttributeData{Trade::MeshAttribute::Position, VertexFormat::Vector3, 0, 0, sizeof(Vector3)}};
+/** splitmix64 finalizer, every input bit affects every output bit */
+inline uint64_t mix(uint64_t x) noexcept
+{
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+/** Hash of the raw coordinates, only used to detect changes */
+size_t hash(const std::vector<Eigen::Vector3d> & points) noexcept
+{
+  uint64_t h = mix(points.size());
+  for(const auto & p : points)
+  {
+    for(Eigen::Index i = 0; i < 3; ++i)
+    {
+      uint64_t bits;
+      std::memcpy(&bits, &p[i], sizeof(bits));
+      h = mix(h ^ mix(bits));
+    }
+  }
+  return static_cast<size_t>(h);
+}
+
+/** Number of segments used to draw a closed polygon with \p points points */
+size_t segments(size_t points) noexcept
+{
+  if(points < 2) { return 0; }
+  if(points == 2) { return 1; }
+  return points;
+}
+
+} // namespace
 
+Polygon::Polygon(Client & client, const ElementId & id, McRtcGui & gui)
+: Widget(client, id, gui), lineShader_(gui.shaders().get<Shaders::LineGL3D>())
+{
+  setupLineMesh(mesh_, vertexBuffer_, indexBuffer_);
+}
+
+void Polygon::write(const PolygonData & polygon, const std::vector<Eigen::Vector3d> & points)
+{
+  LineVertex * out = vertices_.data() + polygon.offset * LineSegmentVertices;
+  for(size_t i = 0; i < polygon.segments; ++i)
+  {
+    writeLineSegment(out + i * LineSegmentVertices, translation(points[i]),
+                     translation(points[(i + 1) % points.size()]), Color4{1.0f});
+  }
 }
 
 void Polygon::data(const std::vector<std::vector<Eigen::Vector3d>> & points, const mc_rtc::gui::LineConfig & config)
 {
-  if(points_ != points)
+  config_ = config;
+  /* If the number of segments of every polygon is unchanged we only rewrite the polygons that moved */
+  bool relayout = points.size() != polygons_.size();
+  for(size_t i = 0; !relayout && i < points.size(); ++i)
   {
-    points_ = points;
-    polygons_.resize(points_.size());
-    for(size_t i = 0; i < points_.size(); ++i)
+    relayout = segments(points[i].size()) != polygons_[i].segments;
+  }
+  if(relayout)
+  {
+    polygons_.resize(points.size());
+    size_t offset = 0;
+    for(size_t i = 0; i < points.size(); ++i)
     {
-      const auto & ps = points[i];
       auto & poly = polygons_[i];
-      if(ps.size() <= 1)
-      {
-        poly.mesh = std::nullopt;
-        continue;
-      }
-      Containers::Array<char> vertexData(ps.size() * sizeof(Vector3));
-      auto positions = Containers::arrayCast<Vector3>(vertexData);
-      for(size_t j = 0; j < ps.size(); ++j) { positions[j] = translation(ps[j]); }
-      Trade::MeshData data{MeshPrimitive::LineLoop, std::move(vertexData),
-                           Trade::meshAttributeDataNonOwningArray(AttributeData3DWireframe),
-                           UnsignedInt(positions.size())};
-      poly.mesh = MeshTools::compileLines(MeshTools::generateLines(data));
+      poly.hash = hash(points[i]);
+      poly.offset = offset;
+      poly.segments = segments(points[i].size());
+      offset += poly.segments;
     }
+    vertices_.resize(offset * LineSegmentVertices);
+    for(size_t i = 0; i < points.size(); ++i) { write(polygons_[i], points[i]); }
+    vertexBuffer_.setData(Containers::arrayView(vertices_.data(), vertices_.size()), GL::BufferUsage::DynamicDraw);
+    reserveLineIndices(indices_, indexBuffer_, offset);
+    mesh_.setCount(static_cast<Int>(offset * LineSegmentIndices));
+    return;
+  }
+  for(size_t i = 0; i < points.size(); ++i)
+  {
+    auto & poly = polygons_[i];
+    size_t h = hash(points[i]);
+    if(h == poly.hash) { continue; }
+    poly.hash = h;
+    write(poly, points[i]);
+    vertexBuffer_.setSubData(poly.offset * LineSegmentVertices * sizeof(LineVertex),
+                             Containers::arrayView(vertices_.data() + poly.offset * LineSegmentVertices,
+                                                   poly.segments * LineSegmentVertices));
   }
-  config_ = config;
 }
 
 void Polygon::draw3D()
 {
-  if(points_.empty()) { return; }
+  if(mesh_.count() == 0) { return; }
   Color4 c = convert(config_.color);
   // This scaling seems to give a nice equivalent to RViZ
   float width = 200.0f * static_cast<float>(config_.width);
   auto & camera = *gui_.camera().camera();
-  for(auto & p : polygons_)
-  {
-    if(!p.mesh) { continue; }
-    lineShader_.setViewportSize(Vector2{GL::defaultFramebuffer.viewport().size()})
-        .setTransformationProjectionMatrix(camera.projectionMatrix() * camera.cameraMatrix())
-        .setColor(c)
-        .setWidth(width)
-        .setSmoothness(1.0f)
-        .draw(*p.mesh);
-  }
+  lineShader_.setViewportSize(Vector2{GL::defaultFramebuffer.viewport().size()})
+      .setTransformationProjectionMatrix(camera.projectionMatrix() * camera.cameraMatrix())
+      .setColor(c)
+      .setWidth(width)
+      .setSmoothness(1.0f);
+  /* The quads are expanded in screen space, their winding depends on the line direction */
+  GL::Renderer::disable(GL::Renderer::Feature::FaceCulling);
+  lineShader_.draw(mesh_);
+  GL::Renderer::enable(GL::Renderer::Feature::FaceCulling);
 }
 
 } // namespace mc_rtc::magnum
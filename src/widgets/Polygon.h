@@ -2,28 +2,39 @@
 
 #include "Widget.h"
 
-#include <Magnum/Shaders/LineGL.h>
+#include "../Lines.h"
 
 namespace mc_rtc::magnum
 {
 
 struct Polygon : public Widget
 {
-  Polygon(Client & client, const ElementId & id, McRtcGui & gui) : Widget(client, id, gui) {}
+  Polygon(Client & client, const ElementId & id, McRtcGui & gui);
 
   void data(const std::vector<std::vector<Eigen::Vector3d>> & points, const mc_rtc::gui::LineConfig & config);
 
   void draw3D() override;
 
 private:
-  std::vector<std::vector<Eigen::Vector3d>> points_;
   mc_rtc::gui::LineConfig config_;
+  /** Range of the segments of a polygon in the shared buffer */
   struct PolygonData
   {
-    std::optional<GL::Mesh> mesh;
+    size_t hash = 0;
+    size_t offset = 0;
+    size_t segments = 0;
   };
   std::vector<PolygonData> polygons_;
-  Shaders::LineGL3D lineShader_;
+  /** Segments of all the polygons, mirrored in vertexBuffer_ */
+  std::vector<LineVertex> vertices_;
+  std::vector<UnsignedInt> indices_;
+  GL::Buffer vertexBuffer_;
+  GL::Buffer indexBuffer_;
+  GL::Mesh mesh_;
+  Shaders::LineGL3D & lineShader_;
+
+  /** Write the segments of \p points at offset in vertices_ */
+  void write(const PolygonData & polygon, const std::vector<Eigen::Vector3d> & points);
 };
 
 } // namespace mc_rtc::magnum
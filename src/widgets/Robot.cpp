@@ -1,5 +1,7 @@
 #include "Robot.h"
 
+#include "../RenderQueue.h"
+
 #include <mc_rbdyn/RobotLoader.h>
 #include <mc_rbdyn/Robots.h>
 
@@ -74,9 +76,14 @@ struct RobotBody : public Object3D, public SceneGraph::Drawable3D
   {
   }
 
-  inline void loadVisual(McRtcGui & gui, const std::string & rm_path, const rbd::parsers::Visual & visual)
+  /** Load \p visual, \p tint replaces the color of its material if provided */
+  inline void loadVisual(McRtcGui & gui,
+                         const std::string & rm_path,
+                         const rbd::parsers::Visual & visual,
+                         const Containers::Optional<Color4> & tint = {})
   {
     std::shared_ptr<CommonDrawable> object;
+    Color4 c = tint ? *tint : color(visual.material);
     using Geometry = rbd::parsers::Geometry;
     switch(visual.geometry.type)
     {
@@ -84,7 +91,7 @@ struct RobotBody : public Object3D, public SceneGraph::Drawable3D
       {
         const auto & mesh = boost::get<rbd::parsers::Geometry::Mesh>(visual.geometry.data);
         auto path = convertURI(mesh.filename, rm_path);
-        object = gui.loadMesh(path.string(), color(visual.material), this, group_);
+        object = gui.loadMesh(path.string(), c, this, group_);
         // FIXME Bake scale in mesh?
         auto scale = mesh.scaleV;
         object->setTransformation(convert(visual.origin) * Matrix4::scaling(translation(scale)));
@@ -94,7 +101,7 @@ struct RobotBody : public Object3D, public SceneGraph::Drawable3D
       {
         const auto & box = boost::get<rbd::parsers::Geometry::Box>(visual.geometry.data);
         object = gui.makeBox(translation(visual.origin.translation()), convert(visual.origin.rotation()),
-                             translation(box.size), color(visual.material), this, group_);
+                             translation(box.size), c, this, group_);
         break;
       }
       case Geometry::CYLINDER:
@@ -111,14 +118,17 @@ struct RobotBody : public Object3D, public SceneGraph::Drawable3D
       case Geometry::SPHERE:
       {
         const auto & sphere = boost::get<rbd::parsers::Geometry::Sphere>(visual.geometry.data);
-        object = gui.makeSphere(translation(visual.origin), static_cast<float>(sphere.radius), color(visual.material),
-                                this, group_);
+        object = gui.makeSphere(translation(visual.origin), static_cast<float>(sphere.radius), c, this, group_);
         break;
       }
       default:
         break;
     }
-    if(object) { objects_.push_back(object); }
+    if(object)
+    {
+      objects_.push_back(object);
+      updateBounds();
+    }
   }
 
   inline void draw(const Matrix4 & transformationMatrix, SceneGraph::Camera3D & camera) final
@@ -126,6 +136,36 @@ struct RobotBody : public Object3D, public SceneGraph::Drawable3D
     for(auto & o : objects_) { o->draw(transformationMatrix * o->transformation(), camera); }
   }
 
+  inline void submit(RenderQueue & queue, const Matrix4 & transformationMatrix)
+  {
+    /* Meshes get their bounds once they are loaded */
+    if(!bounds_) { updateBounds(); }
+    if(bounds_ && !queue.visible(transformationMatrix, *bounds_))
+    {
+      queue.culled(objects_.size());
+      return;
+    }
+    for(auto & o : objects_) { o->submit(queue, transformationMatrix * o->transformation()); }
+  }
+
+  inline size_t size() const noexcept { return objects_.size(); }
+
+  /** Bounds of all the body's visuals, the body is culled as a whole when they are outside of the view */
+  inline void updateBounds() noexcept
+  {
+    bounds_ = Containers::NullOpt;
+    for(const auto & o : objects_)
+    {
+      if(!o->bounds())
+      {
+        bounds_ = Containers::NullOpt;
+        return;
+      }
+      Range3D b = transformBounds(o->transformation(), *o->bounds());
+      bounds_ = bounds_ ? Math::join(*bounds_, b) : b;
+    }
+  }
+
   inline void alpha(float alpha) noexcept
   {
     for(auto & o : objects_) { o->alpha(alpha); }
@@ -133,12 +173,13 @@ struct RobotBody : public Object3D, public SceneGraph::Drawable3D
 
   SceneGraph::DrawableGroup3D * group_;
   std::vector<std::shared_ptr<CommonDrawable>> objects_;
+  Containers::Optional<Range3D> bounds_;
 };
 
 struct RobotObject : public Object3D, public SceneGraph::Drawable3D
 {
-  RobotObject(Scene3D & scene, SceneGraph::DrawableGroup3D & group)
-  : Object3D(&scene), SceneGraph::Drawable3D{*this, &group}, parent_group_(&group)
+  RobotObject(Scene3D & scene, SceneGraph::DrawableGroup3D & group, RenderQueue & queue)
+  : Object3D(&scene), SceneGraph::Drawable3D{*this, &group}, parent_group_(&group), queue_(queue)
   {
   }
 
@@ -152,20 +193,48 @@ struct RobotObject : public Object3D, public SceneGraph::Drawable3D
     }
   }
 
-  inline void loadBody(McRtcGui & gui, const std::string & rm_path, const std::vector<rbd::parsers::Visual> & visuals)
+  inline void loadBody(McRtcGui & gui,
+                       const std::string & rm_path,
+                       const std::vector<rbd::parsers::Visual> & visuals,
+                       const Containers::Optional<Color4> & tint = {})
   {
     bodies_.push_back(std::make_shared<RobotBody>(this, &group_));
-    for(const auto & v : visuals) { bodies_.back()->loadVisual(gui, rm_path, v); }
+    for(const auto & v : visuals) { bodies_.back()->loadVisual(gui, rm_path, v, tint); }
   }
 
-  inline void draw(const Matrix4 & transformationMatrix, SceneGraph::Camera3D & camera) final
+  /** Submit the robot's bodies to the render queue, they are drawn later
+   *
+   * The bodies of the proxy are submitted instead when it is in use
+   */
+  inline void draw(const Matrix4 & transformationMatrix, SceneGraph::Camera3D &) final
   {
     if(visible_)
     {
-      for(auto & b : bodies_) { b->draw(transformationMatrix * b->transformation(), camera); }
+      const auto & bodies = useProxy_ && proxy_ ? proxy_->bodies_ : bodies_;
+      for(auto & b : bodies) { b->submit(queue_, transformationMatrix * b->transformation()); }
     }
   }
 
+  /** Cheaper model with the same bodies drawn instead of this one when \ref useProxy is set */
+  inline void proxy(RobotObject * proxy) noexcept { proxy_ = proxy; }
+
+  inline bool useProxy() const noexcept { return useProxy_; }
+
+  inline void useProxy(bool use) noexcept { useProxy_ = use; }
+
+  /** Bounds of the loaded bodies in the robot frame */
+  inline Containers::Optional<Range3D> bounds() const noexcept
+  {
+    Containers::Optional<Range3D> out;
+    for(const auto & b : bodies_)
+    {
+      if(!b->bounds_) { continue; }
+      Range3D r = transformBounds(b->transformation(), *b->bounds_);
+      out = out ? Math::join(*out, r) : r;
+    }
+    return out;
+  }
+
   inline bool visible() const noexcept { return visible_; }
 
   void visible(bool v) noexcept
@@ -179,25 +248,53 @@ struct RobotObject : public Object3D, public SceneGraph::Drawable3D
   {
     alpha_ = alpha;
     for(auto & b : bodies_) { b->alpha(alpha); }
+    if(proxy_) { proxy_->alpha(alpha); }
   }
 
   inline float alpha() const noexcept { return alpha_; }
 
-  inline void clear() noexcept { bodies_.clear(); }
+  inline void clear() noexcept
+  {
+    bodies_.clear();
+    useProxy_ = false;
+  }
 
   SceneGraph::DrawableGroup3D * parent_group_;
+  RenderQueue & queue_;
   SceneGraph::DrawableGroup3D group_;
   std::vector<std::shared_ptr<RobotBody>> bodies_;
   bool visible_ = true;
   float alpha_ = 1.0f;
+  RobotObject * proxy_ = nullptr;
+  bool useProxy_ = false;
 };
 
 struct RobotImpl
 {
+  /** Projected radius (in pixels) under which the collision model replaces the visual model */
+  static constexpr float ProxyPixels = 100.0f;
+
+  /** The visual model is restored once the projected radius is this much larger than \ref ProxyPixels */
+  static constexpr float ProxyHysteresis = 1.25f;
+
+  /** \ref ProxyPixels is multiplied by this factor when the last frame exceeded the frame budget */
+  static constexpr float ProxyBudgetFactor = 3.0f;
+
+  /** Model drawn for the visual model */
+  enum class Lod
+  {
+    Auto,
+    Visual,
+    Collision
+  };
+
   RobotImpl(Robot & robot, Scene3D & scene, SceneGraph::DrawableGroup3D & group)
-  : self_(robot), visualRobot_(scene, group), collisionRobot_(scene, group)
+  : self_(robot), visualRobot_(scene, group, robot.gui().renderQueue()),
+    collisionRobot_(scene, group, robot.gui().renderQueue()), proxyRobot_(scene, group, robot.gui().renderQueue())
   {
     collisionRobot_.visible(false);
+    proxyRobot_.visible(false);
+    visualRobot_.proxy(&proxyRobot_);
     visualRobot_.visible(self_.id.category.size() <= 1 || self_.id.category[0] != "Robots");
   }
 
@@ -213,6 +310,8 @@ struct RobotImpl
     {
       visualRobot_.clear();
       collisionRobot_.clear();
+      proxyRobot_.clear();
+      hasProxy_ = true;
       robots_ = RobotCache::get_robot(params);
       const auto & rm = robots_->robot().module();
       const auto & bodies = robot().mb().bodies();
@@ -226,6 +325,17 @@ struct RobotImpl
         const auto & b = bodies[i];
         loadVisuals(visualRobot_, rm._visual, b.name());
         loadVisuals(collisionRobot_, rm._collision, b.name());
+        /* The proxy is the collision model tinted with the color of the body's first visual */
+        auto visual = rm._visual.find(b.name());
+        auto collision = rm._collision.find(b.name());
+        Containers::Optional<Color4> tint;
+        if(visual != rm._visual.end() && !visual->second.empty()) { tint = color(visual->second[0].material); }
+        proxyRobot_.loadBody(gui(), rm.path,
+                             collision != rm._collision.end() ? collision->second
+                                                              : std::vector<rbd::parsers::Visual>{},
+                             tint);
+        /* Bodies with a visual model but no collision model would disappear */
+        hasProxy_ = hasProxy_ && (visualRobot_.bodies_.back()->size() == 0 || proxyRobot_.bodies_.back()->size() != 0);
       }
       visualRobot_.alpha(1.0f);
       collisionRobot_.alpha(1.0f);
@@ -259,6 +369,14 @@ struct RobotImpl
     };
     drawRobotControl(visualRobot_, "visual");
     drawRobotControl(collisionRobot_, "collision");
+    if(hasProxy_)
+    {
+      int lod = static_cast<int>(lod_);
+      if(ImGui::Combo(self_.label("Visual model", self_.id.name).c_str(), &lod, "Auto\0Visual\0Collision\0"))
+      {
+        lod_ = static_cast<Lod>(lod);
+      }
+    }
   }
 
   void draw3D()
@@ -266,6 +384,7 @@ struct RobotImpl
     if(!robots_) { return; }
     visualRobot_.update(robot());
     collisionRobot_.update(robot());
+    updateProxy();
   }
 
 private:
@@ -273,6 +392,33 @@ private:
   std::shared_ptr<mc_rbdyn::Robots> robots_;
   RobotObject visualRobot_;
   RobotObject collisionRobot_;
+  /** Collision model drawn in place of the visual model when the robot is small on screen */
+  RobotObject proxyRobot_;
+  /** False if the collision model cannot stand for the visual model */
+  bool hasProxy_ = false;
+  Lod lod_ = Lod::Auto;
+
+  /** Decide whether the visual model is drawn with its proxy */
+  void updateProxy()
+  {
+    bool proxy = hasProxy_ && lod_ == Lod::Collision;
+    if(hasProxy_ && lod_ == Lod::Auto)
+    {
+      auto bounds = visualRobot_.bounds();
+      if(bounds)
+      {
+        Vector3 center = visualRobot_.transformation().transformPoint(bounds->center());
+        auto & camera = *gui().camera().camera();
+        float pixels = bounds->size().length() / 2.0f
+                       / gui().renderQueue().pixelSize(camera.cameraMatrix().transformPoint(center));
+        float threshold = ProxyPixels * (gui().overBudget() ? ProxyBudgetFactor : 1.0f);
+        if(visualRobot_.useProxy()) { threshold *= ProxyHysteresis; }
+        proxy = pixels < threshold;
+      }
+    }
+    visualRobot_.useProxy(proxy);
+    if(proxy) { proxyRobot_.update(robot()); }
+  }
 };
 
 } // namespace details
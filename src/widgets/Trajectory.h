@@ -2,62 +2,112 @@
 
 #include "Widget.h"
 
+#include "../Lines.h"
+
 namespace mc_rtc::magnum
 {
 
 template<typename T>
 struct Trajectory : public Widget
 {
-  Trajectory(Client & client, const ElementId & id, McRtcGui & gui) : Widget(client, id, gui) {}
+  /** Number of points kept by a trajectory */
+  static constexpr size_t DefaultCapacity = 10000;
+
+  /** Length in pixels under which segments are merged by the level of detail */
+  static constexpr float LodPixels = 2.0f;
+
+  /** Maximum number of poses shown for a PTransformd trajectory */
+  static constexpr size_t MaxFrames = 1000;
+
+  Trajectory(Client & client, const ElementId & id, McRtcGui & gui)
+  : Widget(client, id, gui), line_(DefaultCapacity), poses_(DefaultCapacity),
+    shader_(gui.shaders().get<Shaders::LineGL3D>())
+  {
+  }
 
   void data(const T & point, const mc_rtc::gui::LineConfig & config)
   {
-    points_.push_back(point);
+    push(point);
     config_ = config;
   }
 
   void data(const std::vector<T> & points, const mc_rtc::gui::LineConfig & config)
   {
-    points_ = points;
     config_ = config;
+    if(same(points)) { return; }
+    line_.clear();
+    poses_.clear();
+    size_t start = points.size() > line_.capacity() ? points.size() - line_.capacity() : 0;
+    for(size_t i = start; i < points.size(); ++i) { push(points[i]); }
   }
 
   void draw3D() override
   {
-    if(points_.size() < 2) { return; }
+    const auto & points = line_.points();
+    if(points.size() < 2) { return; }
     auto c = convert(config_.color);
-    for(size_t i = 0; i < points_.size() - 1; ++i)
-    {
-      const auto & p0 = points_[i];
-      const auto & p1 = points_[i + 1];
-      gui_.drawLine(translation(p0), translation(p1), c);
-    }
+    // Same scaling as Polygon
+    float width = 200.0f * static_cast<float>(config_.width);
+    auto & camera = *gui_.camera().camera();
+    shader_.setViewportSize(Vector2{GL::defaultFramebuffer.viewport().size()})
+        .setTransformationProjectionMatrix(camera.projectionMatrix() * camera.cameraMatrix())
+        .setColor(c)
+        .setWidth(width)
+        .setSmoothness(1.0f);
+    /* Pick the coarsest level whose segments stay under LodPixels on screen around the closest sampled point */
+    const auto & queue = gui_.renderQueue();
+    auto pixelSize = [&](const Vector3 & p) { return queue.pixelSize(camera.cameraMatrix().transformPoint(p)); };
+    float pixel = std::min({pixelSize(points.front()), pixelSize(points[points.size() / 2]), pixelSize(points.back())});
+    size_t level = line_.level(LodPixels * pixel);
+    line_.draw(shader_, level);
+    const auto & tail = line_.tail(level);
+    for(size_t i = 1; i < tail.size(); ++i) { gui_.drawLine(tail[i - 1], tail[i], c, width); }
     if constexpr(std::is_same_v<T, sva::PTransformd>)
     {
-      if(points_.size() < 10) // For "small" trajectories, display all points
-      {
-        for(const auto & p : points_) { gui_.drawFrame(convert(p)); }
-      }
-      else // Otherwise draw the start and end points
-      {
-        gui_.drawFrame(convert(points_[0]));
-        gui_.drawFrame(convert(points_.back()));
-      }
+      size_t stride = std::max(LineLod::decimation(level), (poses_.size() + MaxFrames - 1) / MaxFrames);
+      for(size_t i = 0; i < poses_.size(); i += stride) { gui_.drawFrame(poses_[i]); }
+      if((poses_.size() - 1) % stride != 0) { gui_.drawFrame(poses_.back()); }
     }
     else
     {
-      if(!startMarker_) { startMarker_ = gui_.makeBox(translation(points_[0]), {}, {0.04, 0.04, 0.04}, c); }
-      startMarker_->pose(Matrix4::from(Matrix3{Math::IdentityInit}, translation(points_[0])));
-      if(!sphereMarker_) { sphereMarker_ = gui_.makeSphere(translation(points_.back()), 0.04f, c); }
-      sphereMarker_->center(translation(points_.back()));
+      if(!startMarker_) { startMarker_ = gui_.makeBox(points.front(), {}, {0.04, 0.04, 0.04}, c); }
+      startMarker_->pose(Matrix4::from(Matrix3{Math::IdentityInit}, points.front()));
+      if(!sphereMarker_) { sphereMarker_ = gui_.makeSphere(points.back(), 0.04f, c); }
+      sphereMarker_->center(points.back());
     }
   }
 
 private:
-  std::vector<T> points_;
+  LineLod line_;
+  /** Only used for PTransformd trajectories */
+  RingBuffer<Matrix4> poses_;
   mc_rtc::gui::LineConfig config_;
+  Shaders::LineGL3D & shader_;
   BoxPtr startMarker_;
   SpherePtr sphereMarker_;
+
+  void push(const T & point)
+  {
+    line_.push(translation(point));
+    if constexpr(std::is_same_v<T, sva::PTransformd>) { poses_.push_back(convert(point)); }
+  }
+
+  /** True if \p points matches the (possibly truncated) history */
+  bool same(const std::vector<T> & points) const
+  {
+    const auto & current = line_.points();
+    size_t start = points.size() > line_.capacity() ? points.size() - line_.capacity() : 0;
+    if(points.size() - start != current.size()) { return false; }
+    for(size_t i = 0; i < current.size(); ++i)
+    {
+      if(translation(points[start + i]) != current[i]) { return false; }
+      if constexpr(std::is_same_v<T, sva::PTransformd>)
+      {
+        if(convert(points[start + i]) != poses_[i]) { return false; }
+      }
+    }
+    return true;
+  }
 };
 
 } // namespace mc_rtc::magnum